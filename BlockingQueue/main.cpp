@@ -1,27 +1,193 @@
 #include <iostream>
+#include <algorithm>
 #include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <stdexcept>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <functional>
+#include <random>
+#include <utility>
+#include <limits>
+#include <cstdint>
 
 class QueueClosed : public std::runtime_error {
 public:
     QueueClosed() : std::runtime_error("Queue closed for Puts") {}
 };
 
+// priority container for BlockingQueue: front() is the greatest item according to Compare, equal items
+// come out in insertion order. push_back/front/pop_front are the container hooks BlockingQueue calls
+// to insert, peek and extract, here they insert into the heap and peek/extract its top.
+template<typename T, class Compare = std::less<T>, size_t Arity = 4>
+class DaryHeap {
+    static_assert(Arity >= 2, "heap arity must be at least 2");
+
+    struct Entry {
+        T item_;
+        uint64_t sequence_;
+    };
+
+public:
+    explicit DaryHeap(Compare compare = Compare()) : compare_(std::move(compare)) {
+    }
+
+    void push_back(T item) {
+        items_.push_back(Entry{std::move(item), next_sequence_++});
+        SiftUp(items_.size() - 1);
+    }
+
+    T &front() {
+        return items_.front().item_;
+    }
+
+    void pop_front() {
+        if (items_.size() > 1) {
+            items_.front() = std::move(items_.back());
+        }
+        items_.pop_back();
+        if (!items_.empty()) {
+            SiftDown(0);
+        }
+    }
+
+    size_t size() const {
+        return items_.size();
+    }
+
+    bool empty() const {
+        return items_.empty();
+    }
+
+private:
+    // lhs is served after rhs: it has lower priority, or the same priority and was inserted later
+    bool RanksBelow(const Entry &lhs, const Entry &rhs) {
+        if (compare_(lhs.item_, rhs.item_)) {
+            return true;
+        }
+        return !compare_(rhs.item_, lhs.item_) && lhs.sequence_ > rhs.sequence_;
+    }
+
+    void SiftUp(size_t index) {
+        Entry entry = std::move(items_[index]);
+        while (index > 0) {
+            size_t parent = (index - 1) / Arity;
+            if (!RanksBelow(items_[parent], entry)) {
+                break;
+            }
+            items_[index] = std::move(items_[parent]);
+            index = parent;
+        }
+        items_[index] = std::move(entry);
+    }
+
+    void SiftDown(size_t index) {
+        Entry entry = std::move(items_[index]);
+        while (true) {
+            size_t first_child = index * Arity + 1;
+            if (first_child >= items_.size()) {
+                break;
+            }
+            size_t last_child = std::min(first_child + Arity, items_.size());
+            size_t best_child = first_child;
+            for (size_t child = first_child + 1; child < last_child; ++child) {
+                if (RanksBelow(items_[best_child], items_[child])) {
+                    best_child = child;
+                }
+            }
+            if (!RanksBelow(entry, items_[best_child])) {
+                break;
+            }
+            items_[index] = std::move(items_[best_child]);
+            index = best_child;
+        }
+        items_[index] = std::move(entry);
+    }
+
+private:
+    std::vector<Entry> items_;
+    Compare compare_;
+    uint64_t next_sequence_{0};
+};
+
+class SelectWaiter {
+public:
+    // returns false if the waiter had already been signalled
+    bool Signal() {
+        std::unique_lock<std::mutex> lock_(mutex_);
+        if (signalled_) {
+            return false;
+        }
+        signalled_ = true;
+        ready_.notify_one();
+        return true;
+    }
+
+    void Wait() {
+        std::unique_lock<std::mutex> lock_(mutex_);
+        while (!signalled_) {
+            ready_.wait(lock_);
+        }
+    }
+
+    // returns true if a signal was consumed
+    bool Reset() {
+        std::unique_lock<std::mutex> lock_(mutex_);
+        bool signalled = signalled_;
+        signalled_ = false;
+        return signalled;
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    bool signalled_{false};
+};
+
+template<typename T, class Container>
+class BlockingQueue;
+
+template<typename T, class Container>
+bool Select(const std::vector<BlockingQueue<T, Container> *> &queues, size_t &index, T &item);
+
+// Container is any sequence with push_back to insert, front/pop_front to peek and extract the next item,
+// size and empty: std::deque gives FIFO order, DaryHeap priority order
 template<typename T, class Container = std::deque<T>>
 class BlockingQueue {
 public:
-    explicit BlockingQueue(const size_t capacity = 0) : capacity_(capacity) {}
+    using Clock = std::chrono::steady_clock;
+
+    struct WakeupStats {
+        size_t signalled_{0};
+        size_t elided_{0};
+    };
+
+    // with elide_wakeups == false every operation notifies, as if someone were waiting
+    explicit BlockingQueue(const size_t capacity = 0, const bool elide_wakeups = true)
+            : capacity_(capacity), elide_wakeups_(elide_wakeups) {}
+
+    // items is the initial storage, e.g. a DaryHeap holding a stateful comparator
+    BlockingQueue(const size_t capacity, Container items, const bool elide_wakeups = true)
+            : capacity_(capacity), elide_wakeups_(elide_wakeups), items_(std::move(items)) {}
 
     void Put(T item) {
         std::unique_lock<std::mutex> lock_(mutex_);
         while (IsFull() && !closed_) {
-            wait_for_place_.wait(lock_);
+            WaitForPlace(lock_);
         }
         if (closed_) {
             throw QueueClosed();
         }
 
         items_.push_back(std::move(item));
-        wait_for_item_.notify_one();
+        NotifyConsumers(1);
     }
 
     bool Get(T &item) {
@@ -30,25 +196,251 @@ public:
             return false;
         }
         while (IsEmpty() && !closed_) {
-            wait_for_item_.wait(lock_);
+            WaitForItem(lock_);
+        }
+        if (IsEmpty()) {
+            return false;
+        }
+        item = std::move(items_.front());
+        items_.pop_front();
+        NotifyProducers(1);
+        return true;
+    }
+
+    // returns false instead of blocking if the queue is full; item is copied or moved from only on success
+    bool TryPut(const T &item) {
+        return DoTryPut(item);
+    }
+
+    bool TryPut(T &&item) {
+        return DoTryPut(std::move(item));
+    }
+
+    // returns false instead of blocking if the queue is empty
+    bool TryGet(T &item) {
+        std::unique_lock<std::mutex> lock_(mutex_);
+        if (IsEmpty()) {
+            return false;
+        }
+
+        item = std::move(items_.front());
+        items_.pop_front();
+        NotifyProducers(1);
+        return true;
+    }
+
+    // returns false if the queue is still full at deadline; item is copied or moved from only on success
+    bool PutUntil(const T &item, const Clock::time_point deadline) {
+        return DoPutUntil(item, deadline);
+    }
+
+    bool PutUntil(T &&item, const Clock::time_point deadline) {
+        return DoPutUntil(std::move(item), deadline);
+    }
+
+    template<typename Rep, typename Period>
+    bool PutFor(const T &item, const std::chrono::duration<Rep, Period> &timeout) {
+        return DoPutUntil(item, Clock::now() + timeout);
+    }
+
+    template<typename Rep, typename Period>
+    bool PutFor(T &&item, const std::chrono::duration<Rep, Period> &timeout) {
+        return DoPutUntil(std::move(item), Clock::now() + timeout);
+    }
+
+    // returns false if no item arrived before deadline or the queue is closed and empty
+    bool GetUntil(T &item, const Clock::time_point deadline) {
+        std::unique_lock<std::mutex> lock_(mutex_);
+        while (IsEmpty() && !closed_) {
+            if (WaitForItemUntil(lock_, deadline) == std::cv_status::timeout && IsEmpty()) {
+                return false;
+            }
         }
         if (IsEmpty()) {
             return false;
         }
+
         item = std::move(items_.front());
         items_.pop_front();
-        wait_for_place_.notify_one();
+        NotifyProducers(1);
         return true;
     }
 
+    template<typename Rep, typename Period>
+    bool GetFor(T &item, const std::chrono::duration<Rep, Period> &timeout) {
+        return GetUntil(item, Clock::now() + timeout);
+    }
+
+    // inserts as many items as fit per lock acquisition, waking consumers once per batch
+    template<typename Iterator>
+    void PutAll(Iterator first, Iterator last) {
+        while (first != last) {
+            std::unique_lock<std::mutex> lock_(mutex_);
+            while (IsFull() && !closed_) {
+                WaitForPlace(lock_);
+            }
+            if (closed_) {
+                throw QueueClosed();
+            }
+
+            size_t inserted = 0;
+            for (; first != last && !IsFull(); ++first, ++inserted) {
+                items_.push_back(*first);
+            }
+            NotifyConsumers(inserted);
+        }
+    }
+
+    // blocks until at least one item is available, returns 0 only if the queue is closed and empty
+    template<typename OutputIterator>
+    size_t GetUpTo(OutputIterator out, const size_t max_items) {
+        if (max_items == 0) {
+            return 0;
+        }
+        std::unique_lock<std::mutex> lock_(mutex_);
+        while (IsEmpty() && !closed_) {
+            WaitForItem(lock_);
+        }
+
+        size_t taken = 0;
+        for (; taken < max_items && !IsEmpty(); ++taken) {
+            *out++ = std::move(items_.front());
+            items_.pop_front();
+        }
+        NotifyProducers(taken);
+        return taken;
+    }
+
     void Close() {
         std::unique_lock<std::mutex> lock_(mutex_);
         closed_ = true;
+        consumers_woken_ = consumers_waiting_;
         wait_for_item_.notify_all();
         wait_for_place_.notify_all();
+        for (auto selector : selectors_) {
+            selector->Signal();
+        }
+    }
+
+    WakeupStats GetWakeupStats() {
+        std::unique_lock<std::mutex> lock_(mutex_);
+        return stats_;
     }
 
 private:
+    template<typename U>
+    bool DoTryPut(U &&item) {
+        std::unique_lock<std::mutex> lock_(mutex_);
+        if (closed_) {
+            throw QueueClosed();
+        }
+        if (IsFull()) {
+            return false;
+        }
+
+        items_.push_back(std::forward<U>(item));
+        NotifyConsumers(1);
+        return true;
+    }
+
+    template<typename U>
+    bool DoPutUntil(U &&item, const Clock::time_point deadline) {
+        std::unique_lock<std::mutex> lock_(mutex_);
+        while (IsFull() && !closed_) {
+            if (WaitForPlaceUntil(lock_, deadline) == std::cv_status::timeout && IsFull() && !closed_) {
+                return false;
+            }
+        }
+        if (closed_) {
+            throw QueueClosed();
+        }
+
+        items_.push_back(std::forward<U>(item));
+        NotifyConsumers(1);
+        return true;
+    }
+
+    void WaitForPlace(std::unique_lock<std::mutex> &lock) {
+        ++producers_waiting_;
+        wait_for_place_.wait(lock);
+        --producers_waiting_;
+    }
+
+    void WaitForItem(std::unique_lock<std::mutex> &lock) {
+        ++consumers_waiting_;
+        wait_for_item_.wait(lock);
+        --consumers_waiting_;
+        ConsumeWakeup();
+    }
+
+    std::cv_status WaitForPlaceUntil(std::unique_lock<std::mutex> &lock, const Clock::time_point deadline) {
+        ++producers_waiting_;
+        auto status = wait_for_place_.wait_until(lock, deadline);
+        --producers_waiting_;
+        return status;
+    }
+
+    std::cv_status WaitForItemUntil(std::unique_lock<std::mutex> &lock, const Clock::time_point deadline) {
+        ++consumers_waiting_;
+        auto status = wait_for_item_.wait_until(lock, deadline);
+        --consumers_waiting_;
+        ConsumeWakeup();
+        return status;
+    }
+
+    // spurious and timed out returns may take a wakeup meant for another waiter,
+    // which only makes NotifyConsumers signal selectors more eagerly
+    void ConsumeWakeup() {
+        if (consumers_woken_ > 0) {
+            --consumers_woken_;
+        }
+    }
+
+    void NotifyProducers(const size_t count) {
+        Notify(wait_for_place_, producers_waiting_, count);
+    }
+
+    // Get waiters that were notified but have not retaken mutex_ yet will each take one item,
+    // selectors are signalled for the items left over
+    void NotifyConsumers(const size_t count) {
+        size_t sleeping = consumers_waiting_ - consumers_woken_;
+        if (sleeping > 0 || selectors_.empty()) {
+            consumers_woken_ += Notify(wait_for_item_, sleeping, count);
+        }
+        if (!selectors_.empty() && items_.size() > consumers_woken_) {
+            NotifySelectors(std::min(count, items_.size() - consumers_woken_));
+        }
+    }
+
+    void NotifySelectors(size_t count) {
+        for (auto it = selectors_.begin(); it != selectors_.end() && count > 0; ++it) {
+            if ((*it)->Signal()) {
+                ++stats_.signalled_;
+                --count;
+            }
+        }
+    }
+
+    // returns the number of waiters woken
+    size_t Notify(std::condition_variable &condition, const size_t waiting, const size_t count) {
+        if (count == 0) {
+            return 0;
+        }
+        if (waiting == 0 && elide_wakeups_) {
+            ++stats_.elided_;
+            return 0;
+        }
+
+        ++stats_.signalled_;
+        if (count == 1 || waiting == 1) {
+            condition.notify_one();
+            return std::min<size_t>(waiting, 1);
+        } else {
+            condition.notify_all();
+            return waiting;
+        }
+    }
+
     bool IsFull() const {
         return capacity_ == 0 ? false : (items_.size() == capacity_);
     }
@@ -57,16 +449,559 @@ private:
         return items_.empty();
     }
 
+    friend bool Select<>(const std::vector<BlockingQueue *> &queues, size_t &index, T &item);
+
+    bool TryGetOrClosed(T &item, bool &closed) {
+        std::unique_lock<std::mutex> lock_(mutex_);
+        if (IsEmpty()) {
+            closed = closed_;
+            return false;
+        }
+
+        item = std::move(items_.front());
+        items_.pop_front();
+        NotifyProducers(1);
+        return true;
+    }
+
+    // returns false instead of registering if there is already something to report
+    bool RegisterSelector(SelectWaiter *selector) {
+        std::unique_lock<std::mutex> lock_(mutex_);
+        if (!IsEmpty() || closed_) {
+            return false;
+        }
+        selectors_.push_back(selector);
+        return true;
+    }
+
+    void UnregisterSelector(SelectWaiter *selector) {
+        std::unique_lock<std::mutex> lock_(mutex_);
+        selectors_.erase(std::find(selectors_.begin(), selectors_.end(), selector));
+    }
+
+    // passes a wakeup on to another consumer if items are left behind
+    void HandOff() {
+        std::unique_lock<std::mutex> lock_(mutex_);
+        if (!IsEmpty()) {
+            NotifyConsumers(1);
+        }
+    }
+
 private:
     size_t capacity_;
+    bool elide_wakeups_;
     Container items_;
     bool closed_{false};
+    size_t producers_waiting_{0};
+    size_t consumers_waiting_{0};
+    size_t consumers_woken_{0};
+    WakeupStats stats_;
+    std::vector<SelectWaiter *> selectors_;
     std::condition_variable wait_for_place_;
     std::condition_variable wait_for_item_;
     std::mutex mutex_;
 };
 
-int main() {
-    std::cout << "Hello, World!" << std::endl;
+// waits until one of queues has an item and returns true with the item and its queue index;
+// closed and drained queues are skipped, false is returned once all of them are;
+// lower indices are served first when several queues are ready
+template<typename T, class Container>
+bool Select(const std::vector<BlockingQueue<T, Container> *> &queues, size_t &index, T &item) {
+    SelectWaiter waiter;
+    std::vector<bool> closed(queues.size(), false);
+    bool woken = false;
+
+    while (true) {
+        size_t num_closed = 0;
+        for (size_t i = 0; i < queues.size(); ++i) {
+            bool drained = false;
+            if (queues[i]->TryGetOrClosed(item, drained)) {
+                index = i;
+                // a signal consumed here may have been meant for an item that is still queued
+                if (woken) {
+                    for (auto queue : queues) {
+                        queue->HandOff();
+                    }
+                }
+                return true;
+            }
+            closed[i] = drained;
+            num_closed += drained ? 1 : 0;
+        }
+        if (num_closed == queues.size()) {
+            return false;
+        }
+
+        // a queue that got an item or was closed since the scan stops the registration and is rescanned
+        size_t registered = 0;
+        while (registered < queues.size() && (closed[registered] || queues[registered]->RegisterSelector(&waiter))) {
+            ++registered;
+        }
+        if (registered == queues.size()) {
+            waiter.Wait();
+        }
+        for (size_t i = 0; i < registered; ++i) {
+            if (!closed[i]) {
+                queues[i]->UnregisterSelector(&waiter);
+            }
+        }
+        woken = waiter.Reset() || woken;
+    }
+}
+
+constexpr size_t kCacheLineSize = 64;
+
+template<typename T>
+class BoundedBlockingQueue {
+    using Storage = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+
+public:
+    explicit BoundedBlockingQueue(const size_t capacity) : capacity_(capacity), items_(new Storage[capacity]) {
+        if (capacity == 0) {
+            throw std::invalid_argument("BoundedBlockingQueue needs a positive capacity");
+        }
+    }
+
+    ~BoundedBlockingQueue() {
+        for (size_t count = count_.load(); count > 0; --count) {
+            Item(head_).~T();
+            head_ = Next(head_);
+        }
+    }
+
+    void Put(T item) {
+        size_t count_before;
+        {
+            std::unique_lock<std::mutex> lock_(put_mutex_);
+            while (count_.load() == capacity_ && !closed_) {
+                wait_for_place_.wait(lock_);
+            }
+            if (closed_) {
+                throw QueueClosed();
+            }
+
+            new(&items_[tail_]) T(std::move(item));
+            tail_ = Next(tail_);
+            count_before = count_.fetch_add(1);
+            if (count_before + 1 < capacity_) {
+                wait_for_place_.notify_one();
+            }
+        }
+
+        if (count_before == 0) {
+            std::unique_lock<std::mutex> lock_(get_mutex_);
+            wait_for_item_.notify_one();
+        }
+    }
+
+    bool Get(T &item) {
+        size_t count_before;
+        {
+            std::unique_lock<std::mutex> lock_(get_mutex_);
+            while (count_.load() == 0 && !closed_) {
+                wait_for_item_.wait(lock_);
+            }
+            if (count_.load() == 0) {
+                return false;
+            }
+
+            item = std::move(Item(head_));
+            Item(head_).~T();
+            head_ = Next(head_);
+            count_before = count_.fetch_sub(1);
+            if (count_before > 1) {
+                wait_for_item_.notify_one();
+            }
+        }
+
+        if (count_before == capacity_) {
+            std::unique_lock<std::mutex> lock_(put_mutex_);
+            wait_for_place_.notify_one();
+        }
+        return true;
+    }
+
+    void Close() {
+        std::unique_lock<std::mutex> put_lock_(put_mutex_, std::defer_lock);
+        std::unique_lock<std::mutex> get_lock_(get_mutex_, std::defer_lock);
+        std::lock(put_lock_, get_lock_);
+        closed_ = true;
+        wait_for_item_.notify_all();
+        wait_for_place_.notify_all();
+    }
+
+private:
+    size_t Next(const size_t index) const {
+        return index + 1 == capacity_ ? 0 : index + 1;
+    }
+
+    T &Item(const size_t index) {
+        return *reinterpret_cast<T *>(&items_[index]);
+    }
+
+private:
+    const size_t capacity_;
+    std::unique_ptr<Storage[]> items_;
+    bool closed_{false};
+    char padding_[kCacheLineSize];
+
+    std::atomic<size_t> count_{0};
+    char count_padding_[kCacheLineSize];
+
+    std::mutex put_mutex_;
+    std::condition_variable wait_for_place_;
+    size_t tail_{0};
+    char put_padding_[kCacheLineSize];
+
+    std::mutex get_mutex_;
+    std::condition_variable wait_for_item_;
+    size_t head_{0};
+};
+
+// relaxed FIFO: items are spread over shards_per_thread * num_threads locked shards, Get takes the older
+// front of two random shards, so an item may overtake others that were put at about the same time
+template<typename T>
+class MultiQueue {
+    static constexpr uint64_t kEmpty = std::numeric_limits<uint64_t>::max();
+    static constexpr size_t kLockAttempts = 4;
+
+    struct Shard {
+        std::mutex mutex_;
+        std::deque<std::pair<uint64_t, T>> items_;
+        // stamp of the front item, read without the lock to choose a shard
+        std::atomic<uint64_t> front_stamp_{kEmpty};
+        char padding_[kCacheLineSize];
+    };
+
+public:
+    explicit MultiQueue(const size_t num_threads = std::thread::hardware_concurrency(),
+                        const size_t shards_per_thread = 2)
+            : num_shards_(std::max<size_t>(1, num_threads * shards_per_thread)), shards_(new Shard[num_shards_]) {
+    }
+
+    void Put(T item) {
+        if (closed_.load()) {
+            throw QueueClosed();
+        }
+
+        Shard &shard = LockRandomShard();
+        // stamped under the shard lock so stamps never decrease along a shard
+        uint64_t stamp = std::chrono::steady_clock::now().time_since_epoch().count();
+        shard.items_.emplace_back(stamp, std::move(item));
+        if (shard.items_.size() == 1) {
+            shard.front_stamp_.store(stamp);
+        }
+        shard.mutex_.unlock();
+
+        // pairs with the fence in Get: either the waiter sees the item or we see the waiter
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (consumers_waiting_.load(std::memory_order_relaxed) > 0) {
+            std::unique_lock<std::mutex> lock_(wait_mutex_);
+            wait_for_item_.notify_one();
+        }
+    }
+
+    // returns false only if every shard looked empty
+    bool TryGet(T &item) {
+        for (size_t attempt = 0; attempt < kLockAttempts; ++attempt) {
+            Shard &first = shards_[NextRandom() % num_shards_];
+            Shard &second = shards_[NextRandom() % num_shards_];
+            Shard &older = first.front_stamp_.load() <= second.front_stamp_.load() ? first : second;
+            if (older.front_stamp_.load() == kEmpty) {
+                break;
+            }
+            if (older.mutex_.try_lock()) {
+                if (PopLocked(older, item)) {
+                    return true;
+                }
+            }
+        }
+
+        // the sampled shards were empty or busy: sweep all of them before giving up
+        size_t start = NextRandom() % num_shards_;
+        for (size_t i = 0; i < num_shards_; ++i) {
+            Shard &shard = shards_[(start + i) % num_shards_];
+            if (shard.front_stamp_.load() == kEmpty) {
+                continue;
+            }
+            shard.mutex_.lock();
+            if (PopLocked(shard, item)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // blocks until an item is available, returns false if the queue is closed and empty
+    bool Get(T &item) {
+        if (TryGet(item)) {
+            return true;
+        }
+
+        std::unique_lock<std::mutex> lock_(wait_mutex_);
+        consumers_waiting_.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool got_item = false;
+        while (!(got_item = TryGet(item)) && !closed_.load()) {
+            wait_for_item_.wait(lock_);
+        }
+        consumers_waiting_.fetch_sub(1);
+        return got_item;
+    }
+
+    // Puts racing with Close may still succeed, their items are handed out before Get reports closed
+    void Close() {
+        std::unique_lock<std::mutex> lock_(wait_mutex_);
+        closed_.store(true);
+        wait_for_item_.notify_all();
+    }
+
+    size_t NumShards() const {
+        return num_shards_;
+    }
+
+private:
+    Shard &LockRandomShard() {
+        for (size_t attempt = 0; attempt < kLockAttempts; ++attempt) {
+            Shard &shard = shards_[NextRandom() % num_shards_];
+            if (shard.mutex_.try_lock()) {
+                return shard;
+            }
+        }
+        Shard &shard = shards_[NextRandom() % num_shards_];
+        shard.mutex_.lock();
+        return shard;
+    }
+
+    // unlocks the shard
+    bool PopLocked(Shard &shard, T &item) {
+        if (shard.items_.empty()) {
+            shard.mutex_.unlock();
+            return false;
+        }
+        item = std::move(shard.items_.front().second);
+        shard.items_.pop_front();
+        shard.front_stamp_.store(shard.items_.empty() ? kEmpty : shard.items_.front().first);
+        shard.mutex_.unlock();
+        return true;
+    }
+
+    static uint64_t NextRandom() {
+        thread_local uint64_t state = reinterpret_cast<uintptr_t>(&state) | 1;
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+
+private:
+    const size_t num_shards_;
+    std::unique_ptr<Shard[]> shards_;
+    std::atomic<bool> closed_{false};
+    char padding_[kCacheLineSize];
+
+    std::atomic<size_t> consumers_waiting_{0};
+    std::mutex wait_mutex_;
+    std::condition_variable wait_for_item_;
+};
+
+template<typename T>
+constexpr uint64_t MultiQueue<T>::kEmpty;
+
+template<typename T>
+constexpr size_t MultiQueue<T>::kLockAttempts;
+
+template<typename Queue>
+double MeasureThroughput(Queue &queue, const size_t num_producers, const size_t num_consumers,
+                         const size_t items_per_producer, const size_t work_per_item = 0) {
+    std::vector<std::thread> producers;
+    std::vector<std::thread> consumers;
+
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < num_consumers; ++i) {
+        consumers.emplace_back([&queue, work_per_item] {
+            int item = 0;
+            while (queue.Get(item)) {
+                for (volatile size_t work = 0; work < work_per_item; ++work) {
+                }
+            }
+        });
+    }
+    for (size_t i = 0; i < num_producers; ++i) {
+        producers.emplace_back([&queue, items_per_producer] {
+            for (size_t sent = 0; sent < items_per_producer; ++sent) {
+                queue.Put(static_cast<int>(sent));
+            }
+        });
+    }
+    for (auto &producer : producers) {
+        producer.join();
+    }
+    queue.Close();
+    for (auto &consumer : consumers) {
+        consumer.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+    return num_producers * items_per_producer / elapsed.count();
+}
+
+void TwoLockBenchmark(const size_t num_threads, const size_t capacity) {
+    const size_t items_per_producer = 1000000;
+
+    BlockingQueue<int> single_lock(capacity);
+    BoundedBlockingQueue<int> two_lock(capacity);
+    std::cout << num_threads << " producers, " << num_threads << " consumers, capacity " << capacity << '\n'
+              << "single lock deque: " << MeasureThroughput(single_lock, num_threads, num_threads, items_per_producer)
+              << " items/s\n"
+              << "two lock ring: " << MeasureThroughput(two_lock, num_threads, num_threads, items_per_producer)
+              << " items/s\n";
+}
+
+void WakeupElisionBenchmark(const size_t num_threads, const size_t work_per_item) {
+    const size_t items_per_producer = 1000000;
+
+    std::cout << num_threads << " producers, " << num_threads << " busy consumers, unbounded\n";
+    for (bool elide_wakeups : {false, true}) {
+        BlockingQueue<int> queue(0, elide_wakeups);
+        double throughput = MeasureThroughput(queue, num_threads, num_threads, items_per_producer, work_per_item);
+        auto stats = queue.GetWakeupStats();
+        std::cout << (elide_wakeups ? "waiter-aware: " : "always notify: ") << throughput << " items/s"
+                  << "\tsignalled: " << stats.signalled_ << "\telided: " << stats.elided_ << '\n';
+    }
+}
+
+template<typename Container>
+double MeasurePriorityThroughput(const size_t num_threads, const size_t num_items) {
+    using PrioritizedItem = std::pair<int, size_t>;
+    BlockingQueue<PrioritizedItem, Container> queue;
+    const size_t items_per_producer = num_items / num_threads;
+
+    std::vector<std::thread> producers;
+    std::vector<std::thread> consumers;
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < num_threads; ++i) {
+        consumers.emplace_back([&queue] {
+            PrioritizedItem item;
+            while (queue.Get(item)) {
+            }
+        });
+        producers.emplace_back([&queue, items_per_producer, i] {
+            std::minstd_rand generator(static_cast<unsigned>(i + 1));
+            for (size_t sent = 0; sent < items_per_producer; ++sent) {
+                queue.Put(PrioritizedItem(static_cast<int>(generator() % 1000), sent));
+            }
+        });
+    }
+    for (auto &producer : producers) {
+        producer.join();
+    }
+    queue.Close();
+    for (auto &consumer : consumers) {
+        consumer.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+    return items_per_producer * num_threads / elapsed.count();
+}
+
+void PriorityBenchmark(const size_t num_threads, const size_t num_items) {
+    using PrioritizedItem = std::pair<int, size_t>;
+
+    std::cout << num_items << " mixed-priority items, " << num_threads << " producers and consumers\n"
+              << "fifo deque: " << MeasurePriorityThroughput<std::deque<PrioritizedItem>>(num_threads, num_items)
+              << " items/s\n"
+              << "binary heap: "
+              << MeasurePriorityThroughput<DaryHeap<PrioritizedItem, std::less<PrioritizedItem>, 2>>(num_threads, num_items)
+              << " items/s\n"
+              << "4-ary heap: "
+              << MeasurePriorityThroughput<DaryHeap<PrioritizedItem, std::less<PrioritizedItem>, 4>>(num_threads, num_items)
+              << " items/s\n";
+}
+
+void MultiQueueBenchmark(const size_t num_threads) {
+    const size_t items_per_producer = 1000000;
+
+    BlockingQueue<int> strict;
+    std::cout << num_threads << " producers, " << num_threads << " consumers, unbounded\n"
+              << "strict fifo: " << MeasureThroughput(strict, num_threads, num_threads, items_per_producer)
+              << " items/s\n";
+    for (size_t shards_per_thread : {1, 2, 4}) {
+        MultiQueue<int> relaxed(2 * num_threads, shards_per_thread);
+        std::cout << "multiqueue, " << relaxed.NumShards() << " shards: "
+                  << MeasureThroughput(relaxed, num_threads, num_threads, items_per_producer) << " items/s\n";
+    }
+}
+
+// drains a prefilled queue concurrently; an item's rank error is how many older items were still queued
+void RankErrorBenchmark(const size_t num_threads, const size_t num_items) {
+    for (size_t shards_per_thread : {1, 2, 4}) {
+        MultiQueue<size_t> queue(num_threads, shards_per_thread);
+        for (size_t i = 0; i < num_items; ++i) {
+            queue.Put(i);
+        }
+        queue.Close();
+
+        std::vector<size_t> taken_order(num_items);
+        std::atomic<size_t> next_ticket{0};
+        std::vector<std::thread> consumers;
+        for (size_t i = 0; i < num_threads; ++i) {
+            consumers.emplace_back([&queue, &taken_order, &next_ticket] {
+                size_t item = 0;
+                while (queue.Get(item)) {
+                    taken_order[next_ticket.fetch_add(1)] = item;
+                }
+            });
+        }
+        for (auto &consumer : consumers) {
+            consumer.join();
+        }
+
+        // Fenwick tree over the items still in the queue
+        std::vector<size_t> remaining(num_items + 1, 0);
+        for (size_t i = 1; i <= num_items; ++i) {
+            remaining[i] += 1;
+            size_t parent = i + (i & (~i + 1));
+            if (parent <= num_items) {
+                remaining[parent] += remaining[i];
+            }
+        }
+        double total_error = 0;
+        size_t max_error = 0;
+        for (size_t item : taken_order) {
+            size_t older = 0;
+            for (size_t i = item; i > 0; i -= i & (~i + 1)) {
+                older += remaining[i];
+            }
+            for (size_t i = item + 1; i <= num_items; i += i & (~i + 1)) {
+                remaining[i] -= 1;
+            }
+            total_error += older;
+            max_error = std::max(max_error, older);
+        }
+
+        std::cout << queue.NumShards() << " shards, " << num_threads << " consumers: mean rank error "
+                  << total_error / num_items << ", max " << max_error << '\n';
+    }
+}
+
+int main(int argc, char **argv) {
+    std::string mode = argc > 1 ? argv[1] : "two-lock";
+    size_t num_threads = argc > 2 ? std::stoull(argv[2]) : 4;
+
+    if (mode == "two-lock") {
+        size_t capacity = argc > 3 ? std::stoull(argv[3]) : 1024;
+        TwoLockBenchmark(num_threads, capacity);
+    } else if (mode == "elision") {
+        size_t work_per_item = argc > 3 ? std::stoull(argv[3]) : 200;
+        WakeupElisionBenchmark(num_threads, work_per_item);
+    } else if (mode == "priority") {
+        size_t num_items = argc > 3 ? std::stoull(argv[3]) : 1000000;
+        PriorityBenchmark(num_threads, num_items);
+    } else if (mode == "multiqueue") {
+        MultiQueueBenchmark(num_threads);
+    } else if (mode == "rank-error") {
+        size_t num_items = argc > 3 ? std::stoull(argv[3]) : 1000000;
+        RankErrorBenchmark(num_threads, num_items);
+    }
+
     return 0;
-}
\ No newline at end of file
+}
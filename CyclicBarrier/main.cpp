@@ -1,10 +1,581 @@
 #include <iostream>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <utility>
+#include <functional>
+#include <stdexcept>
+#include <chrono>
+#include <string>
+#include <climits>
+#include <cstdint>
+#include <cerrno>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 
+// returns false if the wait timed out
+bool FutexWait(std::atomic<uint32_t> *address, const uint32_t expected, const timespec *timeout = nullptr) {
+    long result = syscall(SYS_futex, reinterpret_cast<uint32_t *>(address), FUTEX_WAIT_PRIVATE, expected,
+                          timeout, nullptr, 0);
+    return result == 0 || errno != ETIMEDOUT;
+}
+
+void FutexWake(std::atomic<uint32_t> *address, const int count) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(address), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+}
+
+constexpr size_t kCacheLineSize = 64;
+
+enum class BarrierMode {
+    // one shared counter, fine for a few threads
+    kCentral,
+    // arrivals combine up a tree of counters, fan_in threads per node
+    kCombiningTree,
+    // log(num_threads) rounds of signalling fan_in partners, no shared counter at all
+    kDissemination,
+};
+
+// sense-reversing: the last arrival runs the completion and flips phase_, everyone else spins and then parks on it.
+// The tree and dissemination modes hand each of at most num_threads threads a participant id on its first pass,
+// or take it from the caller through PassThrough(participant); one barrier should stick to one of the two.
 class CyclicBarrier {
+    static constexpr size_t kSpinAttempts = 1000;
+    static constexpr size_t kNoParent = SIZE_MAX;
+    static constexpr uint64_t kNoInstance = UINT64_MAX;
+
+    struct TreeNode {
+        std::atomic<size_t> remaining_{0};
+        size_t expected_{0};
+        size_t parent_{kNoParent};
+        char padding_[kCacheLineSize - sizeof(std::atomic<size_t>) - 2 * sizeof(size_t)];
+    };
+
+    struct Flag {
+        std::atomic<uint32_t> arrivals_{0};
+        std::atomic<uint32_t> sleeping_{0};
+        char padding_[kCacheLineSize - 2 * sizeof(std::atomic<uint32_t>)];
+    };
+
+    struct Participant {
+        size_t passes_{0};
+        char padding_[kCacheLineSize - sizeof(size_t)];
+    };
+
 public:
-    explicit CyclicBarrier(const size_t num_threads) : num_threads_(num_threads), threads_waiting_(num_threads) {
+    // the phase an arrival belongs to, pass it to Wait
+    using ArrivalToken = uint32_t;
+
+    explicit CyclicBarrier(const size_t num_threads, const BarrierMode mode = BarrierMode::kCentral,
+                           const size_t fan_in = 4)
+            : CyclicBarrier(num_threads, nullptr, mode, fan_in) {
+    }
+
+    // completion runs on the last arriving thread before anyone is released;
+    // the dissemination mode has no last arrival and does not support it
+    CyclicBarrier(const size_t num_threads, std::function<void()> completion,
+                  const BarrierMode mode = BarrierMode::kCentral, const size_t fan_in = 4)
+            : num_threads_(num_threads),
+              completion_(std::move(completion)),
+              mode_(mode),
+              fan_in_(std::max<size_t>(fan_in, 2)),
+              spin_attempts_(num_threads <= std::thread::hardware_concurrency() ? kSpinAttempts : 0),
+              instance_(NextInstance()),
+              num_participants_(num_threads),
+              remaining_(num_threads) {
+        if (completion_ && mode_ == BarrierMode::kDissemination) {
+            throw std::logic_error("dissemination barrier has no completion step");
+        }
+        if (mode_ != BarrierMode::kCentral) {
+            thread_ids_.reset(new std::atomic<std::thread::id>[num_threads_]);
+            for (size_t i = 0; i < num_threads_; ++i) {
+                thread_ids_[i].store(std::thread::id());
+            }
+        }
+        if (mode_ == BarrierMode::kCombiningTree) {
+            BuildTree();
+        } else if (mode_ == BarrierMode::kDissemination) {
+            for (size_t reach = 1; reach < num_threads_; reach *= fan_in_ + 1) {
+                ++num_rounds_;
+            }
+            flags_.reset(new Flag[num_threads_ * 2 * num_rounds_]);
+            participants_.reset(new Participant[num_threads_]);
+        }
+    }
+
+    CyclicBarrier(const CyclicBarrier &) = delete;
+    CyclicBarrier &operator=(const CyclicBarrier &) = delete;
+
+    void PassThrough() {
+        DoPassThrough(mode_ == BarrierMode::kCentral ? 0 : ThisThreadParticipant());
+    }
+
+    // counts this thread as arrived without waiting for the others;
+    // the dissemination mode has no split phase and waits for the others here already
+    ArrivalToken Arrive() {
+        return DoArrive(mode_ == BarrierMode::kCentral ? 0 : ThisThreadParticipant());
+    }
+
+    // saves looking up the id of the calling thread; a participant id is used by one thread at a time
+    void PassThrough(const size_t participant) {
+        DoPassThrough(CheckParticipant(participant));
+    }
+
+    ArrivalToken Arrive(const size_t participant) {
+        return DoArrive(CheckParticipant(participant));
+    }
+
+    // returns once the phase token was taken in is over
+    void Wait(const ArrivalToken token) {
+        if (mode_ != BarrierMode::kDissemination) {
+            WaitWhile(phase_, token);
+        }
+    }
+
+    // arrives for the current phase and leaves the barrier, later phases wait for one thread less
+    void ArriveAndDrop() {
+        if (mode_ != BarrierMode::kCentral) {
+            throw std::logic_error("only the central barrier supports dropping threads");
+        }
+        // our own arrival is still pending, so the reset of remaining_ cannot miss this decrement
+        num_participants_.fetch_sub(1);
+        ArriveCentral(phase_.load());
+    }
+
+private:
+    void DoPassThrough(const size_t participant) {
+        if (mode_ == BarrierMode::kDissemination) {
+            PassThroughDissemination(participant);
+        } else {
+            Wait(DoArrive(participant));
+        }
+    }
+
+    ArrivalToken DoArrive(const size_t participant) {
+        // phase_ cannot change before this participant arrives, so this is the phase it waits in
+        uint32_t phase = phase_.load();
+
+        switch (mode_) {
+            case BarrierMode::kCentral:
+                ArriveCentral(phase);
+                break;
+            case BarrierMode::kCombiningTree:
+                ArriveTree(phase, participant);
+                break;
+            case BarrierMode::kDissemination:
+                PassThroughDissemination(participant);
+                break;
+        }
+        return phase;
+    }
+
+    size_t CheckParticipant(const size_t participant) const {
+        if (participant >= num_threads_) {
+            throw std::out_of_range("participant id is not below num_threads");
+        }
+        return participant;
+    }
+
+    // the last barrier a thread passed is cached in the thread, any other barrier scans its own table
+    // of registered threads, so nothing grows beyond num_threads entries per barrier and one per thread
+    size_t ThisThreadParticipant() {
+        thread_local uint64_t cached_instance = kNoInstance;
+        thread_local size_t cached_participant = 0;
+        if (cached_instance == instance_) {
+            return cached_participant;
+        }
+
+        std::thread::id self = std::this_thread::get_id();
+        size_t registered = std::min(next_participant_.load(), num_threads_);
+        size_t participant = registered;
+        for (size_t i = 0; i < registered; ++i) {
+            if (thread_ids_[i].load() == self) {
+                participant = i;
+                break;
+            }
+        }
+        if (participant == registered) {
+            participant = CheckParticipant(next_participant_.fetch_add(1));
+            thread_ids_[participant].store(self);
+        }
+
+        cached_instance = instance_;
+        cached_participant = participant;
+        return participant;
+    }
+
+    static uint64_t NextInstance() {
+        static std::atomic<uint64_t> next_instance{0};
+        return next_instance.fetch_add(1);
+    }
+
+    void ArriveCentral(const uint32_t phase) {
+        if (remaining_.fetch_sub(1) == 1) {
+            remaining_.store(num_participants_.load());
+            Complete(phase);
+        }
+    }
+
+    void ArriveTree(const uint32_t phase, const size_t participant) {
+        size_t index = participant / fan_in_;
+        while (true) {
+            TreeNode &node = tree_[index];
+            if (node.remaining_.fetch_sub(1) != 1) {
+                return;
+            }
+            // the last arrival at a node resets it and carries the whole subtree up
+            node.remaining_.store(node.expected_);
+            if (node.parent_ == kNoParent) {
+                Complete(phase);
+                return;
+            }
+            index = node.parent_;
+        }
+    }
+
+    // round r signals the fan_in threads at distances j * (fan_in + 1)^r and waits for as many signals;
+    // flags alternate between two sets by phase parity so a fast thread cannot signal into a phase still in use
+    void PassThroughDissemination(const size_t self) {
+        Participant &participant = participants_[self];
+        size_t parity = participant.passes_ % 2;
+        auto expected = static_cast<uint32_t>((participant.passes_ / 2 + 1) * fan_in_);
+        ++participant.passes_;
+
+        size_t distance = 1;
+        for (size_t round = 0; round < num_rounds_; ++round, distance *= fan_in_ + 1) {
+            for (size_t j = 1; j <= fan_in_; ++j) {
+                Flag &partner = FlagOf((self + j * distance) % num_threads_, parity, round);
+                partner.arrivals_.fetch_add(1);
+                if (partner.sleeping_.load() > 0) {
+                    FutexWake(&partner.arrivals_, 1);
+                }
+            }
+
+            Flag &own = FlagOf(self, parity, round);
+            WaitUntilReached(own, expected);
+        }
+    }
+
+    void Complete(const uint32_t phase) {
+        if (completion_) {
+            completion_();
+        }
+        phase_.store(phase + 1);
+        if (sleepers_.load() > 0) {
+            FutexWake(&phase_, INT_MAX);
+        }
+    }
+
+    void WaitWhile(std::atomic<uint32_t> &word, const uint32_t value) {
+        for (size_t i = 0; i < spin_attempts_; ++i) {
+            if (word.load(std::memory_order_acquire) != value) {
+                return;
+            }
+        }
+
+        sleepers_.fetch_add(1);
+        while (word.load() == value) {
+            FutexWait(&word, value);
+        }
+        sleepers_.fetch_sub(1);
+    }
+
+    // arrivals only grow, the signed difference keeps the comparison right after wrap-around
+    void WaitUntilReached(Flag &flag, const uint32_t expected) {
+        for (size_t i = 0; i < spin_attempts_; ++i) {
+            if (static_cast<int32_t>(flag.arrivals_.load(std::memory_order_acquire) - expected) >= 0) {
+                return;
+            }
+        }
+
+        flag.sleeping_.store(1);
+        while (true) {
+            uint32_t arrivals = flag.arrivals_.load();
+            if (static_cast<int32_t>(arrivals - expected) >= 0) {
+                break;
+            }
+            FutexWait(&flag.arrivals_, arrivals);
+        }
+        flag.sleeping_.store(0);
+    }
+
+    Flag &FlagOf(const size_t thread, const size_t parity, const size_t round) {
+        return flags_[(thread * 2 + parity) * num_rounds_ + round];
+    }
+
+    void BuildTree() {
+        size_t num_nodes = 0;
+        for (size_t width = num_threads_; ; width = (width + fan_in_ - 1) / fan_in_) {
+            num_nodes += (width + fan_in_ - 1) / fan_in_;
+            if (width <= fan_in_) {
+                break;
+            }
+        }
+        tree_.reset(new TreeNode[num_nodes]);
+
+        // level by level: node i of a level combines children [i * fan_in, (i + 1) * fan_in) of the level below
+        size_t level_begin = 0;
+        for (size_t width = num_threads_; ; width = (width + fan_in_ - 1) / fan_in_) {
+            size_t level_size = (width + fan_in_ - 1) / fan_in_;
+            for (size_t i = 0; i < level_size; ++i) {
+                TreeNode &node = tree_[level_begin + i];
+                node.expected_ = std::min(fan_in_, width - i * fan_in_);
+                node.remaining_.store(node.expected_);
+                if (level_size > 1) {
+                    node.parent_ = level_begin + level_size + i / fan_in_;
+                }
+            }
+            if (width <= fan_in_) {
+                break;
+            }
+            level_begin += level_size;
+        }
+    }
+
+private:
+    const size_t num_threads_;
+    const std::function<void()> completion_;
+    const BarrierMode mode_;
+    const size_t fan_in_;
+    // spinning only pays off when every participant can be running at once
+    const size_t spin_attempts_;
+    // never reused, unlike the address of a destroyed barrier
+    const uint64_t instance_;
+    std::unique_ptr<std::atomic<std::thread::id>[]> thread_ids_;
+    std::atomic<size_t> next_participant_{0};
+    std::unique_ptr<TreeNode[]> tree_;
+    std::unique_ptr<Flag[]> flags_;
+    std::unique_ptr<Participant[]> participants_;
+    size_t num_rounds_{0};
+    std::atomic<size_t> num_participants_;
+    std::atomic<size_t> remaining_;
+    char padding_[kCacheLineSize];
+
+    std::atomic<uint32_t> phase_{0};
+    std::atomic<uint32_t> sleepers_{0};
+};
+
+constexpr size_t CyclicBarrier::kSpinAttempts;
+constexpr size_t CyclicBarrier::kNoParent;
+constexpr uint64_t CyclicBarrier::kNoInstance;
+
+// one-shot gate: Wait returns once CountDown has been called count times in total
+class Latch {
+    static constexpr size_t kSpinAttempts = 1000;
+
+public:
+    explicit Latch(const size_t count) : count_(count), released_(count == 0 ? 1 : 0) {
+    }
+
+    Latch(const Latch &) = delete;
+    Latch &operator=(const Latch &) = delete;
+
+    // counting down past zero still releases the waiters, then throws
+    void CountDown(const size_t count = 1) {
+        size_t previous = count_.load();
+        while (!count_.compare_exchange_weak(previous, previous > count ? previous - count : 0)) {
+        }
+        if (previous > 0 && previous <= count) {
+            released_.store(1);
+            if (sleepers_.load() > 0) {
+                FutexWake(&released_, INT_MAX);
+            }
+        }
+        if (count > previous) {
+            throw std::logic_error("latch counted down past zero");
+        }
+    }
+
+    bool TryWait() const {
+        return released_.load(std::memory_order_acquire) == 1;
+    }
+
+    void Wait() {
+        for (size_t i = 0; i < kSpinAttempts; ++i) {
+            if (TryWait()) {
+                return;
+            }
+        }
+
+        sleepers_.fetch_add(1);
+        while (released_.load() == 0) {
+            FutexWait(&released_, 0);
+        }
+        sleepers_.fetch_sub(1);
+    }
+
+    void ArriveAndWait() {
+        CountDown();
+        Wait();
+    }
+
+private:
+    std::atomic<size_t> count_;
+    std::atomic<uint32_t> released_;
+    std::atomic<uint32_t> sleepers_{0};
+};
+
+constexpr size_t Latch::kSpinAttempts;
+
+// barrier with a changing set of parties; phase, parties and unarrived parties share one word,
+// so registering can never race with the advance of a phase. Phase numbers wrap at 2^20.
+class Phaser {
+    static constexpr size_t kSpinAttempts = 1000;
+    static constexpr uint64_t kCountBits = 22;
+    static constexpr uint64_t kPartiesShift = kCountBits;
+    static constexpr uint64_t kPhaseShift = 2 * kCountBits;
+    static constexpr uint64_t kCountMask = (uint64_t(1) << kCountBits) - 1;
+    static constexpr uint32_t kPhaseMask = (uint32_t(1) << (64 - kPhaseShift)) - 1;
+
+public:
+    static constexpr size_t kMaxParties = kCountMask;
+
+    explicit Phaser(const size_t parties = 0) : state_(Pack(0, parties, parties)) {
+        if (parties > kMaxParties) {
+            throw std::length_error("too many phaser parties");
+        }
+    }
+
+    Phaser(const Phaser &) = delete;
+    Phaser &operator=(const Phaser &) = delete;
+
+    // adds parties to the current phase, returns its number
+    uint32_t Register(const size_t parties = 1) {
+        uint64_t state = state_.load();
+        while (true) {
+            if (Parties(state) + parties > kMaxParties) {
+                throw std::length_error("too many phaser parties");
+            }
+            uint64_t next = Pack(Phase(state), Parties(state) + parties, Unarrived(state) + parties);
+            if (state_.compare_exchange_weak(state, next)) {
+                return Phase(state);
+            }
+        }
+    }
+
+    // returns the number of the phase arrived at
+    uint32_t Arrive() {
+        return DoArrive(false);
+    }
+
+    uint32_t ArriveAndDeregister() {
+        return DoArrive(true);
+    }
+
+    // returns once phase is over, with the number of the phase that followed
+    uint32_t AwaitAdvance(const uint32_t phase) {
+        for (size_t i = 0; i < kSpinAttempts; ++i) {
+            uint32_t current = published_phase_.load(std::memory_order_acquire);
+            if (IsAfter(current, phase)) {
+                return current;
+            }
+        }
+
+        sleepers_.fetch_add(1);
+        uint32_t current = published_phase_.load();
+        while (!IsAfter(current, phase)) {
+            FutexWait(&published_phase_, current);
+            current = published_phase_.load();
+        }
+        sleepers_.fetch_sub(1);
+        return current;
+    }
+
+    uint32_t ArriveAndAwaitAdvance() {
+        return AwaitAdvance(Arrive());
+    }
+
+    uint32_t Phase() const {
+        return Phase(state_.load());
+    }
+
+    size_t Parties() const {
+        return Parties(state_.load());
+    }
+
+private:
+    uint32_t DoArrive(const bool deregister) {
+        uint64_t state = state_.load();
+        while (true) {
+            uint32_t phase = Phase(state);
+            uint64_t parties = Parties(state) - (deregister ? 1 : 0);
+            uint64_t unarrived = Unarrived(state);
+            if (unarrived == 0) {
+                throw std::logic_error("phaser arrival without a registered party");
+            }
+
+            // the last arrival opens the next phase for the parties that remain
+            bool last = unarrived == 1;
+            uint64_t next = last ? Pack(NextPhase(phase), parties, parties) : Pack(phase, parties, unarrived - 1);
+            if (state_.compare_exchange_weak(state, next)) {
+                if (last) {
+                    Publish(NextPhase(phase));
+                }
+                return phase;
+            }
+        }
+    }
+
+    // a later phase may complete before an earlier one is published, so only ever move forward
+    void Publish(const uint32_t phase) {
+        uint32_t current = published_phase_.load();
+        while (IsAfter(phase, current) && !published_phase_.compare_exchange_weak(current, phase)) {
+        }
+        if (sleepers_.load() > 0) {
+            FutexWake(&published_phase_, INT_MAX);
+        }
+    }
+
+    static uint32_t NextPhase(const uint32_t phase) {
+        return (phase + 1) & kPhaseMask;
+    }
+
+    static bool IsAfter(const uint32_t phase, const uint32_t other) {
+        uint32_t distance = (phase - other) & kPhaseMask;
+        return distance != 0 && distance <= kPhaseMask / 2;
+    }
+
+    static uint64_t Pack(const uint64_t phase, const uint64_t parties, const uint64_t unarrived) {
+        return (phase << kPhaseShift) | (parties << kPartiesShift) | unarrived;
+    }
+
+    static uint32_t Phase(const uint64_t state) {
+        return static_cast<uint32_t>(state >> kPhaseShift);
+    }
+
+    static uint64_t Parties(const uint64_t state) {
+        return (state >> kPartiesShift) & kCountMask;
+    }
+
+    static uint64_t Unarrived(const uint64_t state) {
+        return state & kCountMask;
+    }
+
+private:
+    std::atomic<uint64_t> state_;
+    char padding_[kCacheLineSize];
+
+    std::atomic<uint32_t> published_phase_{0};
+    std::atomic<uint32_t> sleepers_{0};
+};
+
+constexpr size_t Phaser::kSpinAttempts;
+constexpr uint64_t Phaser::kCountBits;
+constexpr uint64_t Phaser::kPartiesShift;
+constexpr uint64_t Phaser::kPhaseShift;
+constexpr uint64_t Phaser::kCountMask;
+constexpr uint32_t Phaser::kPhaseMask;
+constexpr size_t Phaser::kMaxParties;
+
+class CondVarCyclicBarrier {
+public:
+    explicit CondVarCyclicBarrier(const size_t num_threads) : num_threads_(num_threads), threads_waiting_(num_threads) {
     }
 
     void PassThrough() {
@@ -34,8 +605,171 @@ private:
     std::mutex mutex_;
 };
 
+// pass_through(i) passes thread i through the barrier once
+template<typename PassThrough>
+double MeasurePhases(PassThrough pass_through, const size_t num_threads, const size_t num_phases) {
+    std::vector<std::thread> threads;
 
-int main() {
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < num_threads; ++i) {
+        threads.emplace_back([&pass_through, num_phases, i] {
+            for (size_t phase = 0; phase < num_phases; ++phase) {
+                pass_through(i);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+    return num_phases / elapsed.count();
+}
+
+void PhasesBenchmark(const size_t max_threads, const size_t num_phases, const size_t fan_in) {
+    std::cout << "phases/s, fan-in " << fan_in << '\n';
+    for (size_t num_threads = 2; num_threads <= max_threads; num_threads *= 2) {
+        CondVarCyclicBarrier condition_variables(num_threads);
+        CyclicBarrier central(num_threads, BarrierMode::kCentral);
+        CyclicBarrier tree(num_threads, BarrierMode::kCombiningTree, fan_in);
+        CyclicBarrier dissemination(num_threads, BarrierMode::kDissemination, fan_in);
+        std::cout << num_threads << " threads"
+                  << "\tcondition variables: "
+                  << MeasurePhases([&](size_t) { condition_variables.PassThrough(); }, num_threads, num_phases)
+                  << "\tcentral: " << MeasurePhases([&](size_t i) { central.PassThrough(i); }, num_threads, num_phases)
+                  << "\ttree: " << MeasurePhases([&](size_t i) { tree.PassThrough(i); }, num_threads, num_phases)
+                  << "\tdissemination: "
+                  << MeasurePhases([&](size_t i) { dissemination.PassThrough(i); }, num_threads, num_phases) << '\n';
+    }
+}
+
+// every phase ends with a sum of per-thread partials, done either by an elected thread between two barriers
+// or by the completion of a single one
+void ReductionBenchmark(const size_t num_threads, const size_t num_phases) {
+    std::vector<size_t> partials(num_threads * kCacheLineSize / sizeof(size_t));
+    size_t total = 0;
+    auto reduce = [&partials, &total, num_threads] {
+        for (size_t i = 0; i < num_threads; ++i) {
+            total += partials[i * kCacheLineSize / sizeof(size_t)];
+        }
+    };
+
+    auto measure = [&](CyclicBarrier &barrier, const bool elected) {
+        std::vector<std::thread> threads;
+        auto begin = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < num_threads; ++i) {
+            threads.emplace_back([&, i] {
+                for (size_t phase = 0; phase < num_phases; ++phase) {
+                    partials[i * kCacheLineSize / sizeof(size_t)] = phase + i;
+                    barrier.PassThrough();
+                    if (elected) {
+                        if (i == 0) {
+                            reduce();
+                        }
+                        barrier.PassThrough();
+                    }
+                }
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+        return num_phases / elapsed.count();
+    };
+
+    CyclicBarrier plain(num_threads);
+    CyclicBarrier with_completion(num_threads, reduce);
+    std::cout << num_threads << " threads\telected reducer: " << measure(plain, true) << " phases/s"
+              << "\tcompletion: " << measure(with_completion, false) << " phases/s\n";
+}
+
+// the main thread hands out num_tasks tiny tasks one by one and joins them; returns tasks/s
+template<typename Spawn, typename Finish, typename Join>
+double MeasureJoin(const size_t num_threads, const size_t num_tasks, Spawn spawn, Finish finish, Join join) {
+    std::atomic<size_t> spawned{0};
+    std::atomic<size_t> next{0};
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < num_threads; ++i) {
+        threads.emplace_back([&spawned, &next, &finish, num_tasks] {
+            while (true) {
+                size_t task = next.load();
+                if (task == num_tasks) {
+                    break;
+                }
+                if (task < spawned.load() && next.compare_exchange_weak(task, task + 1)) {
+                    finish();
+                }
+            }
+        });
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < num_tasks; ++i) {
+        spawn();
+        spawned.store(i + 1);
+    }
+    join();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    return num_tasks / elapsed.count();
+}
+
+void JoinBenchmark(const size_t num_threads, const size_t num_tasks) {
+    std::mutex mutex;
+    std::condition_variable all_done;
+    size_t remaining = num_tasks;
+    double condition_variable = MeasureJoin(num_threads, num_tasks, [] {}, [&] {
+        std::unique_lock<std::mutex> lock_(mutex);
+        if (--remaining == 0) {
+            all_done.notify_all();
+        }
+    }, [&] {
+        std::unique_lock<std::mutex> lock_(mutex);
+        all_done.wait(lock_, [&remaining] { return remaining == 0; });
+    });
+
+    Latch latch(num_tasks);
+    double latch_join = MeasureJoin(num_threads, num_tasks, [] {}, [&latch] {
+        latch.CountDown();
+    }, [&latch] {
+        latch.Wait();
+    });
+
+    // every task registers when spawned and deregisters when done, the joiner is a party itself
+    Phaser phaser(1);
+    double phaser_join = MeasureJoin(num_threads, num_tasks, [&phaser] {
+        phaser.Register();
+    }, [&phaser] {
+        phaser.ArriveAndDeregister();
+    }, [&phaser] {
+        phaser.ArriveAndAwaitAdvance();
+    });
+
+    std::cout << num_tasks << " tasks on " << num_threads << " threads, tasks/s"
+              << "\tmutex counter: " << condition_variable << "\tlatch: " << latch_join
+              << "\tphaser: " << phaser_join << '\n';
+}
+
+int main(int argc, char **argv) {
+    std::string mode = argc > 1 ? argv[1] : "phases";
+
+    if (mode == "phases") {
+        size_t max_threads = argc > 2 ? std::stoull(argv[2]) : 64;
+        size_t num_phases = argc > 3 ? std::stoull(argv[3]) : 10000;
+        size_t fan_in = argc > 4 ? std::stoull(argv[4]) : 4;
+        PhasesBenchmark(max_threads, num_phases, fan_in);
+    } else if (mode == "reduction") {
+        size_t num_threads = argc > 2 ? std::stoull(argv[2]) : 4;
+        size_t num_phases = argc > 3 ? std::stoull(argv[3]) : 10000;
+        ReductionBenchmark(num_threads, num_phases);
+    } else if (mode == "join") {
+        size_t num_threads = argc > 2 ? std::stoull(argv[2]) : 4;
+        size_t num_tasks = argc > 3 ? std::stoull(argv[3]) : 1000000;
+        JoinBenchmark(num_threads, num_tasks);
+    }
 
     return 0;
-}
\ No newline at end of file
+}
@@ -1,56 +1,383 @@
 #include <iostream>
 #include <shared_mutex>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
 #include <vector>
 #include <forward_list>
+#include <algorithm>
+#include <string>
+#include <cstdint>
+#include <functional>
+#include <climits>
+#include <cerrno>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// returns false if the wait timed out
+bool FutexWait(std::atomic<uint32_t> *address, const uint32_t expected, const timespec *timeout = nullptr) {
+    long result = syscall(SYS_futex, reinterpret_cast<uint32_t *>(address), FUTEX_WAIT_PRIVATE, expected,
+                          timeout, nullptr, 0);
+    return result == 0 || errno != ETIMEDOUT;
+}
+
+void FutexWake(std::atomic<uint32_t> *address, const int count) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(address), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+}
+
+constexpr size_t kCacheLineSize = 64;
+
+// BRAVO-style table of reader slots shared by all locks: a reader on the fast path publishes the lock it
+// holds in a slot hashed from the lock and its thread, so readers of one lock touch different cache lines
+class VisibleReaders {
+    static constexpr size_t kNumSlots = 1024;
+
+    struct Slot {
+        std::atomic<const void *> lock_{nullptr};
+        char padding_[kCacheLineSize - sizeof(std::atomic<const void *>)];
+    };
 
+public:
+    static VisibleReaders &Instance() {
+        // never destroyed: readers may still be clearing slots while statics are being torn down
+        static VisibleReaders *readers = new VisibleReaders;
+        return *readers;
+    }
+
+    std::atomic<const void *> &SlotFor(const void *lock) {
+        size_t hash = std::hash<const void *>()(lock) ^ ThreadHash();
+        return slots_[hash % kNumSlots].lock_;
+    }
+
+    // waits until no reader publishes lock
+    void WaitForReaders(const void *lock) {
+        for (auto &slot : slots_) {
+            while (slot.lock_.load() == lock) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+private:
+    VisibleReaders() = default;
+
+    static size_t ThreadHash() {
+        static std::atomic<size_t> next_thread{0};
+        thread_local size_t hash = (next_thread.fetch_add(1) + 1) * 0x9E3779B97F4A7C15ull >> 16;
+        return hash;
+    }
+
+private:
+    Slot slots_[kNumSlots];
+};
+
+constexpr size_t VisibleReaders::kNumSlots;
+
+// spin briefly, then sleep on epoch until blocked() turns false
+template<typename Blocked>
+void SpinThenPark(std::atomic<uint32_t> &epoch, std::atomic<uint32_t> &waiting, const size_t spin_attempts,
+                  Blocked blocked) {
+    for (size_t i = 0; i < spin_attempts; ++i) {
+        if (!blocked()) {
+            return;
+        }
+    }
+    while (true) {
+        uint32_t current = epoch.load();
+        waiting.fetch_add(1);
+        bool still_blocked = blocked();
+        if (still_blocked) {
+            FutexWait(&epoch, current);
+        }
+        waiting.fetch_sub(1);
+        if (!still_blocked) {
+            return;
+        }
+    }
+}
+
+// the whole lock state is one word: a writer-held bit, a writer-waiting bit and the reader count.
+// Readers and writers park on separate futex words. With kWritersFirst a waiting writer keeps new readers
+// out and a leaving writer hands over to the next writer; otherwise readers only wait for a writer inside.
+template<bool kWritersFirst>
+class StateWordPolicy {
+    static constexpr uint32_t kWriter = 1;
+    static constexpr uint32_t kWriterWaiting = 2;
+    static constexpr uint32_t kReader = 4;
+    static constexpr uint32_t kBlocksReaders = kWritersFirst ? kWriter | kWriterWaiting : kWriter;
+    static constexpr size_t kSpinAttempts = 100;
+
+public:
+    void LockShared() {
+        uint32_t state = state_.fetch_add(kReader, std::memory_order_acquire);
+        if (state & kBlocksReaders) {
+            UnlockShared();
+            LockSharedSlow();
+        }
+    }
+
+    void UnlockShared() {
+        uint32_t state = state_.fetch_sub(kReader);
+        // the last reader out lets a waiting writer in
+        if (state == (kReader | kWriterWaiting) && writers_waiting_.load() > 0) {
+            Wake(writer_epoch_, 1);
+        }
+    }
+
+    void Lock() {
+        size_t spins = 0;
+        uint32_t state = state_.load();
+        while (true) {
+            if ((state & ~kWriterWaiting) == 0) {
+                // clears the waiting bit, writers still waiting set it again before they park
+                if (state_.compare_exchange_weak(state, kWriter, std::memory_order_acquire)) {
+                    return;
+                }
+            } else if (!(state & kWriterWaiting)) {
+                state_.compare_exchange_weak(state, state | kWriterWaiting);
+            } else if (spins < kSpinAttempts) {
+                ++spins;
+                state = state_.load();
+            } else {
+                SpinThenPark(writer_epoch_, writers_waiting_, 0, [this] {
+                    uint32_t current = state_.load();
+                    return (current & ~kWriterWaiting) != 0 && (current & kWriterWaiting);
+                });
+                state = state_.load();
+            }
+        }
+    }
+
+    void Unlock() {
+        // seq_cst so the waiter counts below are read after the release, pairing with the parking threads
+        state_.fetch_and(~kWriter);
+        bool readers_waiting = readers_waiting_.load() > 0;
+        bool writers_waiting = writers_waiting_.load() > 0;
+        if (kWritersFirst) {
+            if (writers_waiting) {
+                Wake(writer_epoch_, 1);
+            } else if (readers_waiting) {
+                Wake(reader_epoch_, INT_MAX);
+            }
+        } else {
+            // the woken writer sets the waiting bit again, so the last of these readers wakes it once more
+            if (readers_waiting) {
+                Wake(reader_epoch_, INT_MAX);
+            }
+            if (writers_waiting) {
+                Wake(writer_epoch_, 1);
+            }
+        }
+    }
+
+private:
+    void LockSharedSlow() {
+        uint32_t state = state_.load();
+        while (true) {
+            if (!(state & kBlocksReaders)) {
+                if (state_.compare_exchange_weak(state, state + kReader, std::memory_order_acquire)) {
+                    return;
+                }
+            } else {
+                SpinThenPark(reader_epoch_, readers_waiting_, kSpinAttempts, [this] {
+                    return (state_.load() & kBlocksReaders) != 0;
+                });
+                state = state_.load();
+            }
+        }
+    }
+
+    static void Wake(std::atomic<uint32_t> &epoch, const int count) {
+        epoch.fetch_add(1);
+        FutexWake(&epoch, count);
+    }
+
+private:
+    std::atomic<uint32_t> state_{0};
+    std::atomic<uint32_t> reader_epoch_{0};
+    std::atomic<uint32_t> readers_waiting_{0};
+    std::atomic<uint32_t> writer_epoch_{0};
+    std::atomic<uint32_t> writers_waiting_{0};
+};
+
+template<bool kWritersFirst>
+constexpr uint32_t StateWordPolicy<kWritersFirst>::kWriter;
+template<bool kWritersFirst>
+constexpr uint32_t StateWordPolicy<kWritersFirst>::kWriterWaiting;
+template<bool kWritersFirst>
+constexpr uint32_t StateWordPolicy<kWritersFirst>::kReader;
+template<bool kWritersFirst>
+constexpr uint32_t StateWordPolicy<kWritersFirst>::kBlocksReaders;
+template<bool kWritersFirst>
+constexpr size_t StateWordPolicy<kWritersFirst>::kSpinAttempts;
+
+// writers can starve while readers keep overlapping
+using ReaderPreferring = StateWordPolicy<false>;
+// readers can starve under a steady stream of writers
+using WriterPreferring = StateWordPolicy<true>;
+
+// PF-T (Brandenburg, Anderson): writers are served in ticket order, and readers that arrive during a writer
+// phase all enter before the next writer, so either side waits for at most one phase of the other
+class PhaseFair {
+    static constexpr uint32_t kReader = 0x100;
+    static constexpr uint32_t kWriterBits = 0x3;
+    static constexpr uint32_t kWriterPresent = 0x2;
+    static constexpr uint32_t kPhaseId = 0x1;
+    static constexpr size_t kSpinAttempts = 100;
+
+public:
+    void LockShared() {
+        uint32_t writer = readers_in_.fetch_add(kReader, std::memory_order_acquire) & kWriterBits;
+        if (writer != 0) {
+            // wait for this writer phase to end, a later writer has a different phase id
+            SpinThenPark(reader_epoch_, readers_waiting_, kSpinAttempts, [this, writer] {
+                return (readers_in_.load(std::memory_order_acquire) & kWriterBits) == writer;
+            });
+        }
+    }
+
+    void UnlockShared() {
+        readers_out_.fetch_add(kReader);
+        if (draining_.load() > 0) {
+            FutexWake(&readers_out_, 1);
+        }
+    }
+
+    void Lock() {
+        uint32_t ticket = writers_in_.fetch_add(1);
+        SpinThenPark(writers_out_, writers_waiting_, kSpinAttempts, [this, ticket] {
+            return writers_out_.load(std::memory_order_acquire) != ticket;
+        });
+
+        // from here on new readers wait, the ones already counted in readers_in_ must leave first
+        uint32_t readers_before = readers_in_.fetch_add(kWriterPresent | (ticket & kPhaseId));
+        SpinThenPark(readers_out_, draining_, kSpinAttempts, [this, readers_before] {
+            return readers_out_.load(std::memory_order_acquire) != readers_before;
+        });
+    }
+
+    void Unlock() {
+        readers_in_.fetch_and(~kWriterBits);
+        if (readers_waiting_.load() > 0) {
+            Wake(reader_epoch_, INT_MAX);
+        }
+        writers_out_.fetch_add(1);
+        if (writers_waiting_.load() > 0) {
+            // every queued writer checks whether its ticket came up
+            FutexWake(&writers_out_, INT_MAX);
+        }
+    }
+
+private:
+    static void Wake(std::atomic<uint32_t> &epoch, const int count) {
+        epoch.fetch_add(1);
+        FutexWake(&epoch, count);
+    }
+
+private:
+    std::atomic<uint32_t> readers_in_{0};
+    std::atomic<uint32_t> readers_out_{0};
+    std::atomic<uint32_t> draining_{0};
+    std::atomic<uint32_t> reader_epoch_{0};
+    std::atomic<uint32_t> readers_waiting_{0};
+    std::atomic<uint32_t> writers_in_{0};
+    std::atomic<uint32_t> writers_out_{0};
+    std::atomic<uint32_t> writers_waiting_{0};
+};
+
+constexpr uint32_t PhaseFair::kReader;
+constexpr uint32_t PhaseFair::kWriterBits;
+constexpr uint32_t PhaseFair::kWriterPresent;
+constexpr uint32_t PhaseFair::kPhaseId;
+constexpr size_t PhaseFair::kSpinAttempts;
+
+// Policy decides who goes first when readers and writers contend, the reader fast path works the same for all
+template<class Policy = WriterPreferring>
 class ReaderWriterLock {
+    // a writer that had to revoke the reader fast path keeps it off for this many times the revocation cost
+    static constexpr int64_t kInhibitMultiplier = 9;
+
 public:
+    explicit ReaderWriterLock(const bool reader_bias = true) : reader_bias_enabled_(reader_bias),
+                                                              reader_bias_(reader_bias) {
+    }
+
     void lock_shared() {
-        std::unique_lock<std::mutex> lock_(mutex_);
-        while (writer_) {
-            waiter_.wait(lock_);
+        if (reader_bias_.load()) {
+            auto &slot = VisibleReaders::Instance().SlotFor(this);
+            const void *expected = nullptr;
+            if (slot.compare_exchange_strong(expected, this)) {
+                // pairs with the revocation in lock(): either we see it or the writer sees our slot
+                if (reader_bias_.load()) {
+                    FastReaders().push_back(this);
+                    return;
+                }
+                slot.store(nullptr);
+            }
+        }
+
+        policy_.LockShared();
+        if (reader_bias_enabled_ && !reader_bias_.load(std::memory_order_relaxed) && Now() >= inhibit_until_) {
+            reader_bias_.store(true);
         }
-        ++readers_acquires_;
     }
 
     void unlock_shared() {
-        std::unique_lock<std::mutex> lock_(mutex_);
-        ++readers_releases_;
-        if (readers_acquires_ == readers_releases_) {
-            waiter_.notify_all();
+        auto &fast_readers = FastReaders();
+        for (auto it = fast_readers.rbegin(); it != fast_readers.rend(); ++it) {
+            if (*it == this) {
+                fast_readers.erase(std::next(it).base());
+                VisibleReaders::Instance().SlotFor(this).store(nullptr, std::memory_order_release);
+                return;
+            }
         }
+        policy_.UnlockShared();
     }
 
     void lock() {
-        std::unique_lock<std::mutex> lock_(mutex_);
-        while (writer_) {
-            waiter_.wait(lock_);
-        }
-        writer_ = true;
-        while (readers_acquires_ != readers_releases_) {
-            waiter_.wait(lock_);
+        policy_.Lock();
+
+        if (reader_bias_.load(std::memory_order_relaxed)) {
+            reader_bias_.store(false);
+            int64_t start = Now();
+            VisibleReaders::Instance().WaitForReaders(this);
+            int64_t now = Now();
+            inhibit_until_ = now + (now - start) * kInhibitMultiplier;
         }
     }
 
     void unlock() {
-        std::unique_lock<std::mutex> lock_(mutex_);
-        writer_ = false;
-        waiter_.notify_all();
+        policy_.Unlock();
     }
 
 private:
-    std::mutex mutex_;
-    std::condition_variable waiter_;
-    int readers_acquires_{0};
-    int readers_releases_{0};
-    bool writer_{false};
+    static std::vector<const void *> &FastReaders() {
+        thread_local std::vector<const void *> fast_readers;
+        return fast_readers;
+    }
+
+    static int64_t Now() {
+        return std::chrono::steady_clock::now().time_since_epoch().count();
+    }
+
+private:
+    const bool reader_bias_enabled_;
+    std::atomic<bool> reader_bias_;
+    int64_t inhibit_until_{0};
+    Policy policy_;
 };
 
+template<class Policy>
+constexpr int64_t ReaderWriterLock<Policy>::kInhibitMultiplier;
+
 
-template<typename T, class HashFunction = std::hash<T>>
+template<typename T, class HashFunction = std::hash<T>, class LockPolicy = WriterPreferring>
 class StripedHashSet {
 private:
-    using RWLock = ReaderWriterLock;
+    using RWLock = ReaderWriterLock<LockPolicy>;
 
     using ReaderLocker = std::shared_lock<RWLock>;
     using WriterLocker = std::unique_lock<RWLock>;
@@ -1,10 +1,217 @@
 #include <utility>
 #include <atomic>
 #include <iostream>
+#include <vector>
+#include <mutex>
+#include <algorithm>
+#include <limits>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <thread>
+#include <chrono>
+#include <string>
+#include <climits>
+#include <cerrno>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+
+// returns false if the wait timed out
+bool FutexWait(std::atomic<uint32_t> *address, const uint32_t expected, const timespec *timeout = nullptr) {
+    long result = syscall(SYS_futex, reinterpret_cast<uint32_t *>(address), FUTEX_WAIT_PRIVATE, expected,
+                          timeout, nullptr, 0);
+    return result == 0 || errno != ETIMEDOUT;
+}
+
+void FutexWake(std::atomic<uint32_t> *address, const int count) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(address), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+}
+
+class EpochDomain {
+    static constexpr uint64_t kInactive = std::numeric_limits<uint64_t>::max();
+    static constexpr size_t kNumBuckets = 3;
+    static constexpr size_t kAdvancePeriod = 64;
+
+    struct Retired {
+        void *pointer_;
+        void (*deleter_)(void *);
+    };
+
+    struct RetiredBucket {
+        uint64_t epoch_{0};
+        std::vector<Retired> items_;
+    };
+
+    struct EpochRecord {
+        std::atomic<uint64_t> announced_{kInactive};
+        std::atomic<bool> in_use_{false};
+        EpochRecord *next_{nullptr};
+    };
+
+    class ThreadState {
+    public:
+        explicit ThreadState(EpochDomain &domain) : domain_(domain), record_(domain.AcquireRecord()) {
+        }
+
+        ~ThreadState() {
+            record_->in_use_.store(false);
+            for (auto &bucket : buckets_) {
+                domain_.Orphan(bucket);
+            }
+        }
+
+        EpochDomain &domain_;
+        EpochRecord *record_;
+        RetiredBucket buckets_[kNumBuckets];
+        size_t retired_since_advance_{0};
+    };
+
+public:
+    class Guard {
+    public:
+        Guard() : state_(EpochDomain::Instance().GetThreadState()) {
+            state_.domain_.Enter(state_);
+        }
+
+        ~Guard() {
+            state_.record_->announced_.store(kInactive, std::memory_order_release);
+        }
+
+        Guard(const Guard &) = delete;
+        Guard &operator=(const Guard &) = delete;
+
+    private:
+        ThreadState &state_;
+    };
+
+    static EpochDomain &Instance() {
+        // never destroyed: threads may retire nodes while statics are being torn down
+        static EpochDomain *domain = new EpochDomain;
+        return *domain;
+    }
+
+    // must be called while holding a Guard, after the pointer has been unlinked
+    void Retire(void *pointer, void (*deleter)(void *)) {
+        auto &state = GetThreadState();
+        uint64_t epoch = global_epoch_.load();
+        auto &bucket = state.buckets_[epoch % kNumBuckets];
+        if (bucket.epoch_ != epoch) {
+            Free(bucket);
+            bucket.epoch_ = epoch;
+        }
+        bucket.items_.push_back(Retired{pointer, deleter});
+
+        if (++state.retired_since_advance_ >= kAdvancePeriod) {
+            state.retired_since_advance_ = 0;
+            TryAdvance(epoch);
+        }
+    }
+
+private:
+    EpochDomain() = default;
+
+    ThreadState &GetThreadState() {
+        thread_local ThreadState state(*this);
+        return state;
+    }
+
+    EpochRecord *AcquireRecord() {
+        for (auto record = records_.load(); record; record = record->next_) {
+            bool expected = false;
+            if (!record->in_use_ && record->in_use_.compare_exchange_strong(expected, true)) {
+                return record;
+            }
+        }
+
+        auto record = new EpochRecord;
+        record->in_use_.store(true);
+        record->next_ = records_;
+        while (!records_.compare_exchange_strong(record->next_, record)) {
+        }
+        return record;
+    }
+
+    void Enter(ThreadState &state) {
+        uint64_t epoch = global_epoch_.load();
+        state.record_->announced_.store(epoch);
+
+        // nodes retired two epochs ago can no longer be reached by any guard
+        for (auto &bucket : state.buckets_) {
+            if (bucket.epoch_ + 2 <= epoch) {
+                Free(bucket);
+            }
+        }
+    }
+
+    void TryAdvance(uint64_t epoch) {
+        for (auto record = records_.load(); record; record = record->next_) {
+            uint64_t announced = record->announced_.load();
+            if (announced != kInactive && announced != epoch) {
+                return;
+            }
+        }
+        global_epoch_.compare_exchange_strong(epoch, epoch + 1);
+        FreeOrphans();
+    }
+
+    void Free(RetiredBucket &bucket) {
+        for (auto &retired : bucket.items_) {
+            retired.deleter_(retired.pointer_);
+        }
+        bucket.items_.clear();
+    }
+
+    void Orphan(RetiredBucket &bucket) {
+        if (bucket.items_.empty()) {
+            return;
+        }
+        std::unique_lock<std::mutex> lock_(orphans_mutex_);
+        orphans_.push_back(std::move(bucket));
+        bucket.items_.clear();
+        has_orphans_.store(true);
+    }
+
+    void FreeOrphans() {
+        if (!has_orphans_.load()) {
+            return;
+        }
+        std::unique_lock<std::mutex> lock_(orphans_mutex_, std::try_to_lock);
+        if (!lock_.owns_lock()) {
+            return;
+        }
+
+        uint64_t epoch = global_epoch_.load();
+        auto still_reachable = std::partition(orphans_.begin(), orphans_.end(), [epoch](const RetiredBucket &bucket) {
+            return bucket.epoch_ + 2 > epoch;
+        });
+        for (auto it = still_reachable; it != orphans_.end(); ++it) {
+            Free(*it);
+        }
+        orphans_.erase(still_reachable, orphans_.end());
+        has_orphans_.store(!orphans_.empty());
+    }
+
+private:
+    std::atomic<uint64_t> global_epoch_{0};
+    std::atomic<EpochRecord *> records_{nullptr};
+
+    std::mutex orphans_mutex_;
+    std::vector<RetiredBucket> orphans_;
+    std::atomic<bool> has_orphans_{false};
+};
+
+constexpr uint64_t EpochDomain::kInactive;
+constexpr size_t EpochDomain::kNumBuckets;
+constexpr size_t EpochDomain::kAdvancePeriod;
 
 
 template<typename T>
 class LockFreeQueue {
+    static constexpr size_t kSpinAttempts = 100;
+
     struct Node {
         T item_{};
         std::atomic<Node *> next_{nullptr};
@@ -21,45 +228,46 @@ public:
         auto *dummy = new Node{};
         head_ = dummy;
         tail_ = dummy;
-        garbage_ = dummy;
     }
 
     ~LockFreeQueue() {
         while (true) {
-            if (!garbage_.load()) {
+            if (!head_.load()) {
                 break;
             }
-            auto ptr = garbage_.load();
-            garbage_.store(garbage_.load()->next_);
+            auto ptr = head_.load();
+            head_.store(head_.load()->next_);
             delete ptr;
         }
     }
 
     void Enqueue(T item) {
-        counter_.fetch_add(1);
-        Cleaner(head_);
-        auto new_tail = new Node(item);
-        Node *curr_tail = nullptr;
+        auto new_tail = new Node(std::move(item));
+        Append(new_tail, new_tail);
+        WakeSleepers(1);
+    }
 
-        while (true) {
-            curr_tail = tail_;
-            if (!curr_tail->next_) {
-                Node *temp_ptr = nullptr;
-                if (curr_tail->next_.compare_exchange_weak(temp_ptr, new_tail)) {
-                    break;
-                }
-            } else {
-                tail_.compare_exchange_weak(curr_tail, curr_tail->next_);
-            }
+    template<typename Iterator>
+    void EnqueueBatch(Iterator first, Iterator last) {
+        if (first == last) {
+            return;
         }
 
-        tail_.compare_exchange_strong(curr_tail, new_tail);
-        counter_.fetch_sub(1);
+        Node *chain_head = new Node(*first);
+        Node *chain_tail = chain_head;
+        int count = 1;
+        for (++first; first != last; ++first) {
+            auto node = new Node(*first);
+            chain_tail->next_.store(node, std::memory_order_relaxed);
+            chain_tail = node;
+            count = count < INT_MAX ? count + 1 : count;
+        }
+        Append(chain_head, chain_tail);
+        WakeSleepers(count);
     }
 
     bool Dequeue(T &item) {
-        counter_.fetch_add(1);
-        Cleaner(head_);
+        EpochDomain::Guard guard;
 
         while (true) {
             Node *curr_head = head_;
@@ -67,53 +275,387 @@ public:
 
             if (curr_head == curr_tail) {
                 if (!curr_head->next_) {
-                    counter_.fetch_sub(1);
                     return false;
                 } else {
                     tail_.compare_exchange_weak(curr_head, curr_head->next_);
                 }
             } else {
                 if (head_.compare_exchange_weak(curr_head, curr_head->next_)) {
-                    item = curr_head->next_.load()->item_;
-                    counter_.fetch_sub(1);
+                    item = std::move(curr_head->next_.load()->item_);
+                    Retire(curr_head);
                     return true;
                 }
             }
         }
     }
 
+    void DequeueWait(T &item) {
+        DequeueWaitUntil(item, nullptr);
+    }
+
+    // returns false if no item arrived within timeout
+    template<typename Rep, typename Period>
+    bool DequeueWaitFor(T &item, const std::chrono::duration<Rep, Period> &timeout) {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        return DequeueWaitUntil(item, &deadline);
+    }
+
+    // writes up to max_items items to out in FIFO order, returns how many were dequeued
+    template<typename OutputIterator>
+    size_t DequeueBatch(OutputIterator out, const size_t max_items) {
+        if (max_items == 0) {
+            return 0;
+        }
+        EpochDomain::Guard guard;
+
+        while (true) {
+            Node *curr_head = head_;
+            Node *curr_tail = tail_;
+
+            if (curr_head == curr_tail) {
+                if (!curr_head->next_) {
+                    return 0;
+                }
+                tail_.compare_exchange_weak(curr_head, curr_head->next_);
+                continue;
+            }
+
+            // never move head_ past the tail snapshot, so tail_ cannot point to a retired node
+            Node *new_head = curr_head->next_;
+            size_t count = 1;
+            while (count < max_items && new_head != curr_tail) {
+                new_head = new_head->next_;
+                ++count;
+            }
+
+            if (head_.compare_exchange_weak(curr_head, new_head)) {
+                for (Node *node = curr_head; node != new_head;) {
+                    Node *next = node->next_;
+                    *out++ = std::move(next->item_);
+                    Retire(node);
+                    node = next;
+                }
+                return count;
+            }
+        }
+    }
+
 private:
-    void Cleaner(Node *curr_head) {
-        if (counter_.load() == 1) {
-            while (true) {
-                if (garbage_.load() == curr_head) {
-                    return;
+    bool DequeueWaitUntil(T &item, const std::chrono::steady_clock::time_point *deadline) {
+        for (size_t i = 0; i < kSpinAttempts; ++i) {
+            if (Dequeue(item)) {
+                return true;
+            }
+        }
+
+        while (true) {
+            uint32_t wake_epoch = wake_epoch_.load();
+            sleepers_.fetch_add(1);
+            if (Dequeue(item)) {
+                sleepers_.fetch_sub(1);
+                return true;
+            }
+
+            bool timed_out = false;
+            if (deadline) {
+                auto remaining = *deadline - std::chrono::steady_clock::now();
+                if (remaining <= std::chrono::steady_clock::duration::zero()) {
+                    timed_out = true;
+                } else {
+                    auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(remaining).count();
+                    timespec timeout{static_cast<time_t>(nanoseconds / 1000000000),
+                                     static_cast<long>(nanoseconds % 1000000000)};
+                    timed_out = !FutexWait(&wake_epoch_, wake_epoch, &timeout);
+                }
+            } else {
+                FutexWait(&wake_epoch_, wake_epoch);
+            }
+            sleepers_.fetch_sub(1);
+
+            if (Dequeue(item)) {
+                return true;
+            }
+            if (timed_out) {
+                return false;
+            }
+        }
+    }
+
+    void WakeSleepers(const int count) {
+        if (sleepers_.load() > 0) {
+            wake_epoch_.fetch_add(1);
+            FutexWake(&wake_epoch_, count);
+        }
+    }
+
+    void Append(Node *chain_head, Node *chain_tail) {
+        EpochDomain::Guard guard;
+        Node *curr_tail = nullptr;
+
+        while (true) {
+            curr_tail = tail_;
+            if (!curr_tail->next_) {
+                Node *temp_ptr = nullptr;
+                if (curr_tail->next_.compare_exchange_weak(temp_ptr, chain_head)) {
+                    break;
                 }
-                auto ptr = garbage_.load();
-                garbage_.store(garbage_.load()->next_);
-                delete ptr;
+            } else {
+                tail_.compare_exchange_weak(curr_tail, curr_tail->next_);
             }
         }
+
+        tail_.compare_exchange_strong(curr_tail, chain_tail);
+    }
+
+    static void Retire(Node *node) {
+        EpochDomain::Instance().Retire(node, [](void *ptr) {
+            delete static_cast<Node *>(ptr);
+        });
     }
 
 private:
-    std::atomic<Node *> garbage_{nullptr};
     std::atomic<Node *> head_{nullptr};
     std::atomic<Node *> tail_{nullptr};
 
-    std::atomic<int> counter_{0};
+    std::atomic<uint32_t> wake_epoch_{0};
+    std::atomic<uint32_t> sleepers_{0};
+};
+
+template<typename T>
+constexpr size_t LockFreeQueue<T>::kSpinAttempts;
+
+constexpr size_t kCacheLineSize = 64;
+
+template<typename T>
+class SegmentedQueue {
+    static constexpr size_t kSegmentSize = 1024;
+
+    enum SlotState : uint32_t {
+        kEmpty, kWriting, kReady, kTaken
+    };
+
+    struct Slot {
+        std::atomic<uint32_t> state_{kEmpty};
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage_;
+
+        T &Item() {
+            return *reinterpret_cast<T *>(&storage_);
+        }
+    };
+
+    struct Segment {
+        std::atomic<size_t> enqueue_index_{0};
+        char enqueue_padding_[kCacheLineSize - sizeof(std::atomic<size_t>)];
+        std::atomic<size_t> dequeue_index_{0};
+        char dequeue_padding_[kCacheLineSize - sizeof(std::atomic<size_t>)];
+        std::atomic<Segment *> next_{nullptr};
+        Slot slots_[kSegmentSize];
+
+        ~Segment() {
+            for (auto &slot : slots_) {
+                if (slot.state_.load() == kReady) {
+                    slot.Item().~T();
+                }
+            }
+        }
+    };
+
+public:
+    SegmentedQueue() {
+        auto *segment = new Segment;
+        head_ = segment;
+        tail_ = segment;
+    }
+
+    ~SegmentedQueue() {
+        while (true) {
+            if (!head_.load()) {
+                break;
+            }
+            auto ptr = head_.load();
+            head_.store(head_.load()->next_);
+            delete ptr;
+        }
+    }
+
+    void Enqueue(T item) {
+        EpochDomain::Guard guard;
+
+        while (true) {
+            Segment *curr_tail = tail_;
+            size_t index = curr_tail->enqueue_index_.fetch_add(1);
+
+            if (index >= kSegmentSize) {
+                if (curr_tail != tail_.load()) {
+                    continue;
+                }
+                Segment *next = curr_tail->next_;
+                if (!next) {
+                    auto new_segment = new Segment;
+                    if (curr_tail->next_.compare_exchange_strong(next, new_segment)) {
+                        next = new_segment;
+                    } else {
+                        delete new_segment;
+                    }
+                }
+                tail_.compare_exchange_strong(curr_tail, next);
+                continue;
+            }
+
+            auto &slot = curr_tail->slots_[index];
+            uint32_t state = kEmpty;
+            if (slot.state_.compare_exchange_strong(state, kWriting)) {
+                new(&slot.storage_) T(std::move(item));
+                slot.state_.store(kReady, std::memory_order_release);
+                return;
+            }
+        }
+    }
+
+    bool Dequeue(T &item) {
+        EpochDomain::Guard guard;
+
+        while (true) {
+            Segment *curr_head = head_;
+            if (curr_head->dequeue_index_.load() >= curr_head->enqueue_index_.load() && !curr_head->next_.load()) {
+                return false;
+            }
+
+            size_t index = curr_head->dequeue_index_.fetch_add(1);
+            if (index >= kSegmentSize) {
+                Segment *next = curr_head->next_;
+                if (!next) {
+                    return false;
+                }
+                if (head_.compare_exchange_strong(curr_head, next)) {
+                    Segment *curr_tail = curr_head;
+                    tail_.compare_exchange_strong(curr_tail, next);
+                    Retire(curr_head);
+                }
+                continue;
+            }
+
+            // an enqueuer that has not reached its slot yet is sent to another one
+            auto &slot = curr_head->slots_[index];
+            uint32_t state = kEmpty;
+            if (slot.state_.compare_exchange_strong(state, kTaken)) {
+                continue;
+            }
+            while (slot.state_.load(std::memory_order_acquire) != kReady) {
+            }
+            item = std::move(slot.Item());
+            slot.Item().~T();
+            slot.state_.store(kTaken, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+private:
+    static void Retire(Segment *segment) {
+        EpochDomain::Instance().Retire(segment, [](void *ptr) {
+            delete static_cast<Segment *>(ptr);
+        });
+    }
+
+private:
+    std::atomic<Segment *> head_{nullptr};
+    char head_padding_[kCacheLineSize - sizeof(std::atomic<Segment *>)];
+    std::atomic<Segment *> tail_{nullptr};
 };
 
-int main() {
-    LockFreeQueue<int> lockFreeQueue;
-    for (int i = 0; i < 10; ++i) {
-        lockFreeQueue.Enqueue(i);
+template<typename T>
+constexpr size_t SegmentedQueue<T>::kSegmentSize;
+
+template<typename Queue>
+double MeasureThroughput(const size_t num_threads, const size_t ops_per_thread) {
+    Queue queue;
+    std::atomic<bool> start{false};
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < num_threads; ++i) {
+        threads.emplace_back([&queue, &start, ops_per_thread] {
+            int item = 0;
+            while (!start.load()) {
+            }
+            for (size_t op = 0; op < ops_per_thread; op += 2) {
+                queue.Enqueue(static_cast<int>(op));
+                queue.Dequeue(item);
+            }
+        });
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    start.store(true);
+    for (auto &thread : threads) {
+        thread.join();
     }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+    return num_threads * ops_per_thread / elapsed.count();
+}
+
+void ScalingBenchmark(const size_t max_threads, const size_t ops_per_thread) {
+    std::cout << "threads\tmichael-scott ops/s\tsegmented ops/s\n";
+    for (size_t num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+        std::cout << num_threads
+                  << '\t' << MeasureThroughput<LockFreeQueue<int>>(num_threads, ops_per_thread)
+                  << '\t' << MeasureThroughput<SegmentedQueue<int>>(num_threads, ops_per_thread) << '\n';
+    }
+}
+
+double MeasureBatchThroughput(const size_t num_pairs, const size_t items_per_producer, const size_t batch_size) {
+    LockFreeQueue<int> queue;
+    std::atomic<size_t> consumed{0};
+    const size_t total_items = num_pairs * items_per_producer;
+    std::vector<std::thread> threads;
 
-    for (int i = 0; i < 10; ++i) {
-        int a = -1;
-        lockFreeQueue.Dequeue(a);
-        std::cout << a << ' ';
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < num_pairs; ++i) {
+        threads.emplace_back([&queue, items_per_producer, batch_size] {
+            std::vector<int> batch(batch_size);
+            for (size_t sent = 0; sent < items_per_producer; sent += batch_size) {
+                queue.EnqueueBatch(batch.begin(), batch.end());
+            }
+        });
+        threads.emplace_back([&queue, &consumed, total_items, batch_size] {
+            std::vector<int> batch(batch_size);
+            while (consumed.load() < total_items) {
+                consumed.fetch_add(queue.DequeueBatch(batch.begin(), batch_size));
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+    return total_items / elapsed.count();
+}
+
+void BatchBenchmark(const size_t num_pairs, const size_t items_per_producer) {
+    std::cout << "batch size\titems/s\n";
+    for (size_t batch_size : {1, 64, 1024}) {
+        std::cout << batch_size << '\t' << MeasureBatchThroughput(num_pairs, items_per_producer, batch_size) << '\n';
+    }
+}
+
+int main(int argc, char **argv) {
+    std::string mode = argc > 1 ? argv[1] : "demo";
+
+    if (mode == "demo") {
+        LockFreeQueue<int> lockFreeQueue;
+        for (int i = 0; i < 10; ++i) {
+            lockFreeQueue.Enqueue(i);
+        }
+
+        for (int i = 0; i < 10; ++i) {
+            int a = -1;
+            lockFreeQueue.Dequeue(a);
+            std::cout << a << ' ';
+        }
+    } else if (mode == "scaling") {
+        size_t max_threads = argc > 2 ? std::stoull(argv[2]) : 64;
+        ScalingBenchmark(max_threads, 1000000);
+    } else if (mode == "batch") {
+        size_t num_pairs = argc > 2 ? std::stoull(argv[2]) : 4;
+        BatchBenchmark(num_pairs, 1 << 20);
     }
 
     return 0;
@@ -1,7 +1,451 @@
 #include <utility>
 #include <atomic>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <random>
+#include <new>
+#include <cstdint>
+#include <type_traits>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <unistd.h>
+
+constexpr size_t kCacheLineSize = 64;
+
+class HazardPointerDomain {
+    struct HazardRecord {
+        std::atomic<void *> pointer_{nullptr};
+        std::atomic<bool> active_{false};
+        HazardRecord *next_{nullptr};
+    };
+
+    struct Retired {
+        void *pointer_;
+        void (*deleter_)(void *);
+    };
+
+    class ThreadState {
+    public:
+        explicit ThreadState(HazardPointerDomain &domain) : domain_(domain), record_(domain.AcquireRecord()) {
+        }
+
+        ~ThreadState() {
+            record_->pointer_.store(nullptr);
+            record_->active_.store(false);
+            domain_.Scan(*this);
+            domain_.Orphan(retired_);
+        }
+
+        HazardPointerDomain &domain_;
+        HazardRecord *record_;
+        std::vector<Retired> retired_;
+        std::vector<void *> hazards_;
+    };
+
+public:
+    static HazardPointerDomain &Instance() {
+        // never destroyed: deleters of orphaned nodes may outlive other statics
+        static HazardPointerDomain *domain = new HazardPointerDomain;
+        return *domain;
+    }
+
+    std::atomic<void *> &Hazard() {
+        return GetThreadState().record_->pointer_;
+    }
+
+    void Retire(void *pointer, void (*deleter)(void *)) {
+        auto &state = GetThreadState();
+        state.retired_.push_back(Retired{pointer, deleter});
+        if (state.retired_.size() >= RetireThreshold()) {
+            Scan(state);
+        }
+    }
+
+private:
+    static constexpr size_t kMinRetireThreshold = 64;
+
+    HazardPointerDomain() = default;
+
+    ThreadState &GetThreadState() {
+        thread_local ThreadState state(*this);
+        return state;
+    }
+
+    size_t RetireThreshold() const {
+        return std::max(kMinRetireThreshold, 2 * records_count_.load());
+    }
+
+    HazardRecord *AcquireRecord() {
+        for (auto record = records_.load(); record; record = record->next_) {
+            bool expected = false;
+            if (!record->active_ && record->active_.compare_exchange_strong(expected, true)) {
+                return record;
+            }
+        }
+
+        auto record = new HazardRecord;
+        record->active_.store(true);
+        record->next_ = records_;
+        while (!records_.compare_exchange_strong(record->next_, record)) {
+        }
+        records_count_.fetch_add(1);
+        return record;
+    }
+
+    void Scan(ThreadState &state) {
+        auto &retired = state.retired_;
+        auto &hazards = state.hazards_;
+        AdoptOrphans(retired);
+
+        hazards.clear();
+        for (auto record = records_.load(); record; record = record->next_) {
+            if (auto pointer = record->pointer_.load()) {
+                hazards.push_back(pointer);
+            }
+        }
+        std::sort(hazards.begin(), hazards.end());
+
+        auto still_protected = std::partition(retired.begin(), retired.end(), [&hazards](const Retired &item) {
+            return std::binary_search(hazards.begin(), hazards.end(), item.pointer_);
+        });
+        for (auto it = still_protected; it != retired.end(); ++it) {
+            it->deleter_(it->pointer_);
+        }
+        retired.erase(still_protected, retired.end());
+    }
+
+    void Orphan(std::vector<Retired> &retired) {
+        std::unique_lock<std::mutex> lock_(orphans_mutex_);
+        orphans_.insert(orphans_.end(), retired.begin(), retired.end());
+        has_orphans_.store(true);
+        retired.clear();
+    }
+
+    void AdoptOrphans(std::vector<Retired> &retired) {
+        if (!has_orphans_.load()) {
+            return;
+        }
+        std::unique_lock<std::mutex> lock_(orphans_mutex_, std::try_to_lock);
+        if (lock_.owns_lock()) {
+            retired.insert(retired.end(), orphans_.begin(), orphans_.end());
+            orphans_.clear();
+            has_orphans_.store(false);
+        }
+    }
+
+private:
+    std::atomic<HazardRecord *> records_{nullptr};
+    std::atomic<size_t> records_count_{0};
+
+    std::mutex orphans_mutex_;
+    std::vector<Retired> orphans_;
+    std::atomic<bool> has_orphans_{false};
+};
+
+constexpr size_t HazardPointerDomain::kMinRetireThreshold;
+
+template<typename T>
+class AtomicTaggedPointer {
+    using PackedPointer = uintptr_t;
+
+    static constexpr unsigned kTagShift = 48;
+    static constexpr PackedPointer kPointerMask = (PackedPointer{1} << kTagShift) - 1;
+
+    static_assert(sizeof(PackedPointer) == 8, "tag bits require 64-bit pointers");
+
+public:
+    struct TaggedPointer {
+        TaggedPointer(T *ptr, uint16_t tag) : ptr_(ptr), tag_(tag) {
+        }
+
+        T *ptr_;
+        uint16_t tag_;
+    };
+
+public:
+    explicit AtomicTaggedPointer(T *ptr = nullptr) : packed_ptr_{Pack({ptr, 0})} {
+    }
+
+    TaggedPointer Load() const {
+        return Unpack(packed_ptr_.load());
+    }
+
+    // note: the tag of desired is ignored, a successful CAS always bumps the tag
+    bool CompareAndSet(TaggedPointer expected, T *desired) {
+        auto expected_packed = Pack(expected);
+        return packed_ptr_.compare_exchange_strong(
+                expected_packed, Pack({desired, static_cast<uint16_t>(expected.tag_ + 1)}));
+    }
+
+private:
+    static PackedPointer Pack(TaggedPointer tagged_ptr) {
+        return reinterpret_cast<PackedPointer>(tagged_ptr.ptr_) |
+               (static_cast<PackedPointer>(tagged_ptr.tag_) << kTagShift);
+    }
+
+    static TaggedPointer Unpack(PackedPointer packed_ptr) {
+        return {reinterpret_cast<T *>(packed_ptr & kPointerMask), static_cast<uint16_t>(packed_ptr >> kTagShift)};
+    }
+
+private:
+    std::atomic<PackedPointer> packed_ptr_;
+};
+
+template<typename T>
+constexpr unsigned AtomicTaggedPointer<T>::kTagShift;
 
 template<typename T>
+constexpr typename AtomicTaggedPointer<T>::PackedPointer AtomicTaggedPointer<T>::kPointerMask;
+
+template<typename Node>
+class NodePool {
+    static constexpr size_t kBatchSize = 64;
+
+    struct Cell {
+        typename std::aligned_storage<sizeof(Node), alignof(Node)>::type storage_;
+        Cell *next_{nullptr};
+        std::atomic<Cell *> next_batch_{nullptr};
+    };
+
+    struct Chunk {
+        Cell cells_[kBatchSize];
+        Chunk *next_{nullptr};
+    };
+
+    class ThreadCache {
+    public:
+        explicit ThreadCache(NodePool &pool) : pool_(pool) {
+        }
+
+        ~ThreadCache() {
+            while (size_ > 0) {
+                pool_.PushBatch(TakeBatch());
+            }
+            Destroyed() = true;
+        }
+
+        static bool &Destroyed() {
+            thread_local bool destroyed = false;
+            return destroyed;
+        }
+
+        Cell *TakeBatch() {
+            Cell *batch = cells_;
+            Cell *last = cells_;
+            size_t count = 1;
+            for (; count < kBatchSize && last->next_; ++count) {
+                last = last->next_;
+            }
+            cells_ = last->next_;
+            last->next_ = nullptr;
+            size_ -= count;
+            return batch;
+        }
+
+        NodePool &pool_;
+        Cell *cells_{nullptr};
+        size_t size_{0};
+    };
+
+public:
+    static NodePool &Instance() {
+        // never destroyed: retired nodes may come back during thread and static teardown
+        static NodePool *pool = new NodePool;
+        return *pool;
+    }
+
+    template<typename... Args>
+    Node *New(Args &&... args) {
+        auto &cache = GetThreadCache();
+        if (!cache.cells_) {
+            cache.cells_ = PopBatch();
+            for (auto cell = cache.cells_; cell; cell = cell->next_) {
+                ++cache.size_;
+            }
+        }
+
+        Cell *cell = cache.cells_;
+        cache.cells_ = cell->next_;
+        --cache.size_;
+        return new(&cell->storage_) Node(std::forward<Args>(args)...);
+    }
+
+    void Delete(Node *node) {
+        node->~Node();
+        auto cell = reinterpret_cast<Cell *>(node);
+        if (ThreadCache::Destroyed()) {
+            cell->next_ = nullptr;
+            PushBatch(cell);
+            return;
+        }
+
+        auto &cache = GetThreadCache();
+        cell->next_ = cache.cells_;
+        cache.cells_ = cell;
+        if (++cache.size_ >= 2 * kBatchSize) {
+            PushBatch(cache.TakeBatch());
+        }
+    }
+
+    // heap allocations made so far, one per batch of cells
+    size_t Allocations() const {
+        return allocations_.load();
+    }
+
+private:
+    NodePool() = default;
+
+    ThreadCache &GetThreadCache() {
+        thread_local ThreadCache cache(*this);
+        return cache;
+    }
+
+    void PushBatch(Cell *batch) {
+        while (true) {
+            auto head = free_batches_.Load();
+            batch->next_batch_.store(head.ptr_);
+            if (free_batches_.CompareAndSet(head, batch)) {
+                return;
+            }
+        }
+    }
+
+    Cell *PopBatch() {
+        while (true) {
+            auto head = free_batches_.Load();
+            if (!head.ptr_) {
+                return AllocateBatch();
+            }
+            if (free_batches_.CompareAndSet(head, head.ptr_->next_batch_.load())) {
+                return head.ptr_;
+            }
+        }
+    }
+
+    Cell *AllocateBatch() {
+        auto chunk = new Chunk;
+        allocations_.fetch_add(1, std::memory_order_relaxed);
+        for (size_t i = 0; i + 1 < kBatchSize; ++i) {
+            chunk->cells_[i].next_ = &chunk->cells_[i + 1];
+        }
+
+        chunk->next_ = chunks_;
+        while (!chunks_.compare_exchange_strong(chunk->next_, chunk)) {
+        }
+        return chunk->cells_;
+    }
+
+private:
+    AtomicTaggedPointer<Cell> free_batches_;
+    std::atomic<Chunk *> chunks_{nullptr};
+    std::atomic<size_t> allocations_{0};
+};
+
+template<typename Node>
+constexpr size_t NodePool<Node>::kBatchSize;
+
+// the allocating baseline for NodePool: every node is a separate new/delete
+template<typename Node>
+class HeapNodeAllocator {
+public:
+    static HeapNodeAllocator &Instance() {
+        static HeapNodeAllocator *allocator = new HeapNodeAllocator;
+        return *allocator;
+    }
+
+    template<typename... Args>
+    Node *New(Args &&... args) {
+        allocations_.fetch_add(1, std::memory_order_relaxed);
+        return new Node(std::forward<Args>(args)...);
+    }
+
+    void Delete(Node *node) {
+        delete node;
+    }
+
+    size_t Allocations() const {
+        return allocations_.load();
+    }
+
+private:
+    HeapNodeAllocator() = default;
+
+private:
+    std::atomic<size_t> allocations_{0};
+};
+
+template<typename Node>
+class EliminationArray {
+    static constexpr size_t kSpinAttempts = 128;
+
+    struct Slot {
+        std::atomic<Node *> node_{nullptr};
+        char padding_[kCacheLineSize - sizeof(std::atomic<Node *>)];
+    };
+
+public:
+    explicit EliminationArray(const size_t num_slots) : slots_(num_slots) {
+    }
+
+    bool TryPush(Node *node) {
+        if (slots_.empty()) {
+            return false;
+        }
+        auto &slot = RandomSlot();
+        Node *expected = nullptr;
+        if (!slot.node_.compare_exchange_strong(expected, node)) {
+            return false;
+        }
+
+        for (size_t i = 0; i < kSpinAttempts && slot.node_.load() == node; ++i) {
+        }
+
+        expected = node;
+        if (slot.node_.compare_exchange_strong(expected, nullptr)) {
+            return false;
+        }
+        slot.node_.store(nullptr);
+        return true;
+    }
+
+    Node *TryPop() {
+        if (slots_.empty()) {
+            return nullptr;
+        }
+        auto &slot = RandomSlot();
+        Node *node = slot.node_.load();
+        if (!node || node == Taken() || !slot.node_.compare_exchange_strong(node, Taken())) {
+            return nullptr;
+        }
+        return node;
+    }
+
+private:
+    static Node *Taken() {
+        return reinterpret_cast<Node *>(1);
+    }
+
+    Slot &RandomSlot() {
+        thread_local std::minstd_rand generator(std::random_device{}());
+        return slots_[generator() % slots_.size()];
+    }
+
+private:
+    std::vector<Slot> slots_;
+};
+
+template<typename Node>
+constexpr size_t EliminationArray<Node>::kSpinAttempts;
+
+template<typename T, template<typename> class Allocator = NodePool>
 class LockFreeStack {
     struct Node {
         T item_;
@@ -12,47 +456,184 @@ class LockFreeStack {
     };
 
 public:
-    LockFreeStack() = default;
+    class Chain {
+    public:
+        class Iterator : public std::iterator<std::forward_iterator_tag, T> {
+        public:
+            explicit Iterator(Node *node) : node_(node) {
+            }
+
+            T &operator*() const {
+                return node_->item_;
+            }
+
+            T *operator->() const {
+                return &node_->item_;
+            }
+
+            Iterator &operator++() {
+                node_ = node_->next_;
+                return *this;
+            }
+
+            Iterator operator++(int) {
+                Iterator copy = *this;
+                ++*this;
+                return copy;
+            }
+
+            bool operator==(const Iterator &that) const {
+                return node_ == that.node_;
+            }
+
+            bool operator!=(const Iterator &that) const {
+                return node_ != that.node_;
+            }
+
+        private:
+            Node *node_;
+        };
+
+        explicit Chain(Node *head = nullptr) : head_(head) {
+        }
+
+        Chain(Chain &&that) noexcept : head_(that.head_) {
+            that.head_ = nullptr;
+        }
+
+        Chain &operator=(Chain &&that) noexcept {
+            std::swap(head_, that.head_);
+            return *this;
+        }
+
+        ~Chain() {
+            while (head_) {
+                Node *node = head_;
+                head_ = node->next_;
+                Retire(node);
+            }
+        }
+
+        bool Empty() const {
+            return !head_;
+        }
+
+        Iterator begin() const {
+            return Iterator(head_);
+        }
+
+        Iterator end() const {
+            return Iterator(nullptr);
+        }
+
+    private:
+        Node *head_;
+    };
+
+    static constexpr size_t kDefaultEliminationSlots = 8;
+
+    explicit LockFreeStack(const size_t elimination_slots = kDefaultEliminationSlots)
+            : elimination_(elimination_slots) {
+    }
 
     ~LockFreeStack() {
-        Helper(garbage_);
         Helper(top_);
     }
 
     void Push(T item) {
-        auto new_top = new Node(item);
+        auto new_top = Pool().New(std::move(item));
         Node *curr_top = top_;
         new_top->next_ = curr_top;
 
         while (!top_.compare_exchange_strong(curr_top, new_top)) {
+            if (elimination_.TryPush(new_top)) {
+                return;
+            }
             new_top->next_ = curr_top;
         }
     }
 
+    template<typename Iterator>
+    void PushRange(Iterator first, Iterator last) {
+        if (first == last) {
+            return;
+        }
+
+        Node *bottom = Pool().New(*first);
+        Node *new_top = bottom;
+        for (++first; first != last; ++first) {
+            Node *node = Pool().New(*first);
+            node->next_ = new_top;
+            new_top = node;
+        }
+
+        Node *curr_top = top_;
+        bottom->next_ = curr_top;
+        while (!top_.compare_exchange_strong(curr_top, new_top)) {
+            bottom->next_ = curr_top;
+        }
+    }
+
+    // heap allocations made for nodes of every stack sharing this allocator
+    static size_t NodeAllocations() {
+        return Pool().Allocations();
+    }
+
+    Chain PopAll() {
+        return Chain(top_.exchange(nullptr));
+    }
+
+    bool TryPush(T item) {
+        Push(std::move(item));
+        return true;
+    }
+
+    bool TryPop(T &item) {
+        return Pop(item);
+    }
+
     bool Pop(T &item) {
+        auto &domain = HazardPointerDomain::Instance();
+        auto &hazard = domain.Hazard();
         Node *curr_top = top_;
 
         while (true) {
             if (!curr_top) {
+                hazard.store(nullptr);
                 return false;
             }
 
+            hazard.store(curr_top);
+            if (top_.load() != curr_top) {
+                curr_top = top_;
+                continue;
+            }
+
             if (top_.compare_exchange_strong(curr_top, curr_top->next_)) {
-                item = curr_top->item_;
-                Push_garbage(curr_top);
+                hazard.store(nullptr);
+                item = std::move(curr_top->item_);
+                Retire(curr_top);
+                return true;
+            }
+
+            if (Node *partner = elimination_.TryPop()) {
+                hazard.store(nullptr);
+                item = std::move(partner->item_);
+                Pool().Delete(partner);
                 return true;
             }
         }
     }
 
 private:
-    void Push_garbage(Node *node) {
-        Node *curr_top = garbage_;
-        node->next_ = curr_top;
+    static Allocator<Node> &Pool() {
+        return Allocator<Node>::Instance();
+    }
 
-        while (!garbage_.compare_exchange_strong(curr_top, node)) {
-            node->next_ = curr_top;
-        }
+    static void Retire(Node *node) {
+        HazardPointerDomain::Instance().Retire(node, [](void *ptr) {
+            Pool().Delete(static_cast<Node *>(ptr));
+        });
     }
 
     void Helper(std::atomic<Node *> &ptr) {
@@ -62,16 +643,260 @@ private:
                 break;
             }
             ptr.store(ptr.load()->next_);
-            delete curr_top;
+            Pool().Delete(curr_top);
         }
     }
 
 private:
     std::atomic<Node *> top_{nullptr};
-    std::atomic<Node *> garbage_{nullptr};
+    EliminationArray<Node> elimination_;
 };
 
-int main() {
+template<typename T, template<typename> class Allocator>
+constexpr size_t LockFreeStack<T, Allocator>::kDefaultEliminationSlots;
+
+template<typename T>
+class BoundedLockFreeStack {
+    using Index = uint32_t;
+    using PackedTop = uint64_t;
+
+    static constexpr Index kNullIndex = std::numeric_limits<Index>::max();
+
+    // one slot per cache line, so threads working on neighbouring slots do not share lines
+    struct alignas(kCacheLineSize) Slot {
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type item_;
+        std::atomic<Index> next_{kNullIndex};
+    };
+
+    class IndexStack {
+    public:
+        void Push(Slot *slots, const Index index) {
+            PackedTop curr_top = top_;
+            while (true) {
+                slots[index].next_.store(IndexOf(curr_top));
+                if (top_.compare_exchange_weak(curr_top, Pack(index, VersionOf(curr_top) + 1))) {
+                    return;
+                }
+            }
+        }
+
+        Index Pop(Slot *slots) {
+            PackedTop curr_top = top_;
+            while (true) {
+                Index index = IndexOf(curr_top);
+                if (index == kNullIndex) {
+                    return kNullIndex;
+                }
+                Index next = slots[index].next_.load();
+                if (top_.compare_exchange_weak(curr_top, Pack(next, VersionOf(curr_top) + 1))) {
+                    return index;
+                }
+            }
+        }
+
+    private:
+        static PackedTop Pack(const Index index, const uint32_t version) {
+            return (static_cast<PackedTop>(version) << 32) | index;
+        }
+
+        static Index IndexOf(const PackedTop top) {
+            return static_cast<Index>(top);
+        }
+
+        static uint32_t VersionOf(const PackedTop top) {
+            return static_cast<uint32_t>(top >> 32);
+        }
+
+    private:
+        std::atomic<PackedTop> top_{Pack(kNullIndex, 0)};
+        char padding_[kCacheLineSize - sizeof(std::atomic<PackedTop>)];
+    };
+
+public:
+    // indices are packed into 32 bits next to the version, kNullIndex itself is never a slot
+    explicit BoundedLockFreeStack(const size_t capacity)
+            : storage_(new char[CheckCapacity(capacity) * sizeof(Slot) + alignof(Slot)]) {
+        // operator new only guarantees alignof(std::max_align_t) before C++17
+        void *aligned = storage_.get();
+        size_t space = capacity * sizeof(Slot) + alignof(Slot);
+        slots_ = static_cast<Slot *>(std::align(alignof(Slot), capacity * sizeof(Slot), aligned, space));
+        for (size_t i = 0; i < capacity; ++i) {
+            new(&slots_[i]) Slot;
+        }
+
+        for (size_t i = capacity; i > 0; --i) {
+            free_.Push(slots_, static_cast<Index>(i - 1));
+        }
+    }
+
+    ~BoundedLockFreeStack() {
+        for (Index index = items_.Pop(slots_); index != kNullIndex; index = items_.Pop(slots_)) {
+            Item(index).~T();
+        }
+    }
+
+    bool TryPush(T item) {
+        Index index = free_.Pop(slots_);
+        if (index == kNullIndex) {
+            return false;
+        }
+        new(&slots_[index].item_) T(std::move(item));
+        items_.Push(slots_, index);
+        return true;
+    }
+
+    bool TryPop(T &item) {
+        Index index = items_.Pop(slots_);
+        if (index == kNullIndex) {
+            return false;
+        }
+        item = std::move(Item(index));
+        Item(index).~T();
+        free_.Push(slots_, index);
+        return true;
+    }
+
+private:
+    static size_t CheckCapacity(const size_t capacity) {
+        if (capacity > kNullIndex) {
+            throw std::length_error("bounded stack capacity must fit in 32 bits");
+        }
+        return capacity;
+    }
+
+    T &Item(const Index index) {
+        return *reinterpret_cast<T *>(&slots_[index].item_);
+    }
+
+private:
+    IndexStack items_;
+    IndexStack free_;
+    std::unique_ptr<char[]> storage_;
+    Slot *slots_{nullptr};
+};
+
+template<typename T>
+constexpr typename BoundedLockFreeStack<T>::Index BoundedLockFreeStack<T>::kNullIndex;
+
+size_t GetResidentSetKb() {
+    std::ifstream statm("/proc/self/statm");
+    size_t total_pages = 0, resident_pages = 0;
+    statm >> total_pages >> resident_pages;
+    return resident_pages * static_cast<size_t>(sysconf(_SC_PAGESIZE)) / 1024;
+}
+
+void SoakBenchmark(const size_t num_threads, const size_t total_ops, const size_t num_reports) {
+    LockFreeStack<int> stack;
+    const size_t ops_per_report = total_ops / num_threads / num_reports;
+    auto start = std::chrono::steady_clock::now();
+
+    for (size_t report = 1; report <= num_reports; ++report) {
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < num_threads; ++i) {
+            threads.emplace_back([&stack, ops_per_report, i] {
+                int item = 0;
+                for (size_t op = 0; op < ops_per_report; op += 2) {
+                    stack.Push(static_cast<int>(i));
+                    stack.Pop(item);
+                }
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "ops: " << report * ops_per_report * num_threads
+                  << "\telapsed: " << elapsed.count() << "s"
+                  << "\trss: " << GetResidentSetKb() << " KiB\n";
+    }
+}
+
+template<typename Stack>
+double MeasureThroughput(Stack &stack, const size_t num_threads, const size_t ops_per_thread) {
+    std::atomic<bool> start{false};
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < num_threads; ++i) {
+        threads.emplace_back([&stack, &start, ops_per_thread, i] {
+            std::minstd_rand generator(static_cast<unsigned>(i + 1));
+            int item = 0;
+            while (!start.load()) {
+            }
+            for (size_t op = 0; op < ops_per_thread; ++op) {
+                if (generator() % 2) {
+                    stack.TryPush(static_cast<int>(op));
+                } else {
+                    stack.TryPop(item);
+                }
+            }
+        });
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    start.store(true);
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+    return num_threads * ops_per_thread / elapsed.count();
+}
+
+void ScalingBenchmark(const size_t max_threads, const size_t ops_per_thread) {
+    std::cout << "threads\tplain ops/s\telimination ops/s\tbounded ops/s\n";
+    for (size_t num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+        LockFreeStack<int> plain(0);
+        LockFreeStack<int> eliminating;
+        BoundedLockFreeStack<int> bounded(1 << 16);
+        std::cout << num_threads
+                  << '\t' << MeasureThroughput(plain, num_threads, ops_per_thread)
+                  << '\t' << MeasureThroughput(eliminating, num_threads, ops_per_thread)
+                  << '\t' << MeasureThroughput(bounded, num_threads, ops_per_thread) << '\n';
+    }
+}
+
+template<template<typename> class Allocator>
+void MeasureLatency(const char *name, const size_t live_items, const size_t num_ops) {
+    LockFreeStack<int, Allocator> stack;
+    int item = 0;
+    for (size_t i = 0; i < live_items; ++i) {
+        stack.Push(static_cast<int>(i));
+    }
+    for (size_t i = 0; i < live_items; ++i) {
+        stack.Pop(item);
+        stack.Push(item);
+    }
+
+    auto allocations_before = stack.NodeAllocations();
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t op = 0; op < num_ops; op += 2) {
+        stack.Push(static_cast<int>(op));
+        stack.Pop(item);
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - begin;
+
+    std::cout << name << "\tns/op: " << elapsed.count() / num_ops
+              << "\tallocations: " << stack.NodeAllocations() - allocations_before << '\n';
+}
+
+void LatencyBenchmark(const size_t live_items, const size_t num_ops) {
+    MeasureLatency<HeapNodeAllocator>("new/delete", live_items, num_ops);
+    MeasureLatency<NodePool>("node pool", live_items, num_ops);
+}
+
+int main(int argc, char **argv) {
+    std::string mode = argc > 1 ? argv[1] : "scaling";
+
+    if (mode == "soak") {
+        size_t num_threads = std::max(2u, std::thread::hardware_concurrency());
+        size_t total_ops = argc > 2 ? std::stoull(argv[2]) : 100000000;
+        SoakBenchmark(num_threads, total_ops, 10);
+    } else if (mode == "scaling") {
+        size_t max_threads = argc > 2 ? std::stoull(argv[2]) : 64;
+        ScalingBenchmark(max_threads, 1000000);
+    } else if (mode == "latency") {
+        size_t num_ops = argc > 2 ? std::stoull(argv[2]) : 100000000;
+        LatencyBenchmark(1024, num_ops);
+    }
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,203 @@
+#include <atomic>
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <iostream>
+
+constexpr size_t kCacheLineSize = 64;
+
+template<typename T>
+class SPSCRingBuffer {
+    using Storage = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+
+public:
+    explicit SPSCRingBuffer(const size_t capacity)
+            : capacity_(RoundUpToPowerOfTwo(capacity)), mask_(capacity_ - 1), buffer_(new Storage[capacity_]) {
+    }
+
+    ~SPSCRingBuffer() {
+        for (size_t index = consumer_.head_.load(); index != producer_.tail_.load(); ++index) {
+            Item(index).~T();
+        }
+    }
+
+    SPSCRingBuffer(const SPSCRingBuffer &) = delete;
+    SPSCRingBuffer &operator=(const SPSCRingBuffer &) = delete;
+
+    bool TryEnqueue(T item) {
+        size_t tail = producer_.tail_.load(std::memory_order_relaxed);
+        if (FreePlace(tail, 1) == 0) {
+            return false;
+        }
+        new(&buffer_[tail & mask_]) T(std::move(item));
+        producer_.tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool TryDequeue(T &item) {
+        size_t head = consumer_.head_.load(std::memory_order_relaxed);
+        if (AvailableItems(head, 1) == 0) {
+            return false;
+        }
+        item = std::move(Item(head));
+        Item(head).~T();
+        consumer_.head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // moves up to count items out of items, returns how many were enqueued
+    size_t TryEnqueueBatch(T *items, const size_t count) {
+        size_t tail = producer_.tail_.load(std::memory_order_relaxed);
+        size_t batch = std::min(count, FreePlace(tail, count));
+        for (size_t i = 0; i < batch; ++i) {
+            new(&buffer_[(tail + i) & mask_]) T(std::move(items[i]));
+        }
+        if (batch > 0) {
+            producer_.tail_.store(tail + batch, std::memory_order_release);
+        }
+        return batch;
+    }
+
+    // moves up to max_count items into items, returns how many were dequeued
+    size_t TryDequeueBatch(T *items, const size_t max_count) {
+        size_t head = consumer_.head_.load(std::memory_order_relaxed);
+        size_t batch = std::min(max_count, AvailableItems(head, max_count));
+        for (size_t i = 0; i < batch; ++i) {
+            items[i] = std::move(Item(head + i));
+            Item(head + i).~T();
+        }
+        if (batch > 0) {
+            consumer_.head_.store(head + batch, std::memory_order_release);
+        }
+        return batch;
+    }
+
+    size_t Capacity() const {
+        return capacity_;
+    }
+
+private:
+    static size_t RoundUpToPowerOfTwo(const size_t value) {
+        size_t power = 1;
+        while (power < value) {
+            power *= 2;
+        }
+        return power;
+    }
+
+    T &Item(const size_t index) {
+        return *reinterpret_cast<T *>(&buffer_[index & mask_]);
+    }
+
+    size_t FreePlace(const size_t tail, const size_t wanted) {
+        size_t free_place = capacity_ - (tail - producer_.cached_head_);
+        if (free_place < wanted) {
+            producer_.cached_head_ = consumer_.head_.load(std::memory_order_acquire);
+            free_place = capacity_ - (tail - producer_.cached_head_);
+        }
+        return free_place;
+    }
+
+    size_t AvailableItems(const size_t head, const size_t wanted) {
+        size_t available = consumer_.cached_tail_ - head;
+        if (available < wanted) {
+            consumer_.cached_tail_ = producer_.tail_.load(std::memory_order_acquire);
+            available = consumer_.cached_tail_ - head;
+        }
+        return available;
+    }
+
+private:
+    struct ProducerSide {
+        std::atomic<size_t> tail_{0};
+        size_t cached_head_{0};
+        char padding_[kCacheLineSize - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+    };
+
+    struct ConsumerSide {
+        std::atomic<size_t> head_{0};
+        size_t cached_tail_{0};
+        char padding_[kCacheLineSize - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+    };
+
+    char leading_padding_[kCacheLineSize];
+    const size_t capacity_;
+    const size_t mask_;
+    std::unique_ptr<Storage[]> buffer_;
+    char padding_[kCacheLineSize];
+    ProducerSide producer_;
+    ConsumerSide consumer_;
+};
+
+void LatencyBenchmark(const size_t round_trips) {
+    SPSCRingBuffer<size_t> ping(64);
+    SPSCRingBuffer<size_t> pong(64);
+
+    std::thread echo([&ping, &pong, round_trips] {
+        size_t item = 0;
+        for (size_t i = 0; i < round_trips; ++i) {
+            while (!ping.TryDequeue(item)) {
+            }
+            while (!pong.TryEnqueue(item)) {
+            }
+        }
+    });
+
+    auto begin = std::chrono::steady_clock::now();
+    size_t item = 0;
+    for (size_t i = 0; i < round_trips; ++i) {
+        while (!ping.TryEnqueue(i)) {
+        }
+        while (!pong.TryDequeue(item)) {
+        }
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - begin;
+    echo.join();
+
+    std::cout << "handoff latency: " << elapsed.count() / round_trips / 2 << " ns\n";
+}
+
+void ThroughputBenchmark(const size_t num_items, const size_t batch_size) {
+    SPSCRingBuffer<size_t> buffer(1 << 14);
+
+    std::thread consumer([&buffer, num_items, batch_size] {
+        std::vector<size_t> items(batch_size);
+        for (size_t received = 0; received < num_items;) {
+            received += buffer.TryDequeueBatch(items.data(), batch_size);
+        }
+    });
+
+    auto begin = std::chrono::steady_clock::now();
+    std::vector<size_t> items(batch_size);
+    for (size_t sent = 0; sent < num_items;) {
+        size_t count = std::min(batch_size, num_items - sent);
+        for (size_t i = 0; i < count; ++i) {
+            items[i] = sent + i;
+        }
+        for (size_t pushed = 0; pushed < count;) {
+            pushed += buffer.TryEnqueueBatch(items.data() + pushed, count - pushed);
+        }
+        sent += count;
+    }
+    consumer.join();
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - begin;
+
+    std::cout << "batch " << batch_size << ": " << elapsed.count() / num_items << " ns/item\n";
+}
+
+int main(int argc, char **argv) {
+    size_t num_ops = argc > 1 ? std::stoull(argv[1]) : 10000000;
+
+    LatencyBenchmark(num_ops / 10);
+    for (size_t batch_size : {1, 16, 256}) {
+        ThroughputBenchmark(num_ops, batch_size);
+    }
+
+    return 0;
+}
@@ -0,0 +1,717 @@
+#include <utility>
+#include <functional>
+#include <memory>
+#include <cmath>
+#include <atomic>
+#include <iostream>
+#include <vector>
+#include <mutex>
+#include <algorithm>
+#include <limits>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <thread>
+#include <chrono>
+#include <string>
+#include <climits>
+#include <cerrno>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+
+// returns false if the wait timed out
+bool FutexWait(std::atomic<uint32_t> *address, const uint32_t expected, const timespec *timeout = nullptr) {
+    long result = syscall(SYS_futex, reinterpret_cast<uint32_t *>(address), FUTEX_WAIT_PRIVATE, expected,
+                          timeout, nullptr, 0);
+    return result == 0 || errno != ETIMEDOUT;
+}
+
+void FutexWake(std::atomic<uint32_t> *address, const int count) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(address), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+}
+
+class EpochDomain {
+    static constexpr uint64_t kInactive = std::numeric_limits<uint64_t>::max();
+    static constexpr size_t kNumBuckets = 3;
+    static constexpr size_t kAdvancePeriod = 64;
+
+    struct Retired {
+        void *pointer_;
+        void (*deleter_)(void *);
+    };
+
+    struct RetiredBucket {
+        uint64_t epoch_{0};
+        std::vector<Retired> items_;
+    };
+
+    struct EpochRecord {
+        std::atomic<uint64_t> announced_{kInactive};
+        std::atomic<bool> in_use_{false};
+        EpochRecord *next_{nullptr};
+    };
+
+    class ThreadState {
+    public:
+        explicit ThreadState(EpochDomain &domain) : domain_(domain), record_(domain.AcquireRecord()) {
+        }
+
+        ~ThreadState() {
+            record_->in_use_.store(false);
+            for (auto &bucket : buckets_) {
+                domain_.Orphan(bucket);
+            }
+        }
+
+        EpochDomain &domain_;
+        EpochRecord *record_;
+        RetiredBucket buckets_[kNumBuckets];
+        size_t retired_since_advance_{0};
+    };
+
+public:
+    class Guard {
+    public:
+        Guard() : state_(EpochDomain::Instance().GetThreadState()) {
+            state_.domain_.Enter(state_);
+        }
+
+        ~Guard() {
+            state_.record_->announced_.store(kInactive, std::memory_order_release);
+        }
+
+        Guard(const Guard &) = delete;
+        Guard &operator=(const Guard &) = delete;
+
+    private:
+        ThreadState &state_;
+    };
+
+    static EpochDomain &Instance() {
+        // never destroyed: threads may retire nodes while statics are being torn down
+        static EpochDomain *domain = new EpochDomain;
+        return *domain;
+    }
+
+    // must be called while holding a Guard, after the pointer has been unlinked
+    void Retire(void *pointer, void (*deleter)(void *)) {
+        auto &state = GetThreadState();
+        uint64_t epoch = global_epoch_.load();
+        auto &bucket = state.buckets_[epoch % kNumBuckets];
+        if (bucket.epoch_ != epoch) {
+            Free(bucket);
+            bucket.epoch_ = epoch;
+        }
+        bucket.items_.push_back(Retired{pointer, deleter});
+
+        if (++state.retired_since_advance_ >= kAdvancePeriod) {
+            state.retired_since_advance_ = 0;
+            TryAdvance(epoch);
+        }
+    }
+
+private:
+    EpochDomain() = default;
+
+    ThreadState &GetThreadState() {
+        thread_local ThreadState state(*this);
+        return state;
+    }
+
+    EpochRecord *AcquireRecord() {
+        for (auto record = records_.load(); record; record = record->next_) {
+            bool expected = false;
+            if (!record->in_use_ && record->in_use_.compare_exchange_strong(expected, true)) {
+                return record;
+            }
+        }
+
+        auto record = new EpochRecord;
+        record->in_use_.store(true);
+        record->next_ = records_;
+        while (!records_.compare_exchange_strong(record->next_, record)) {
+        }
+        return record;
+    }
+
+    void Enter(ThreadState &state) {
+        uint64_t epoch = global_epoch_.load();
+        state.record_->announced_.store(epoch);
+
+        // nodes retired two epochs ago can no longer be reached by any guard
+        for (auto &bucket : state.buckets_) {
+            if (bucket.epoch_ + 2 <= epoch) {
+                Free(bucket);
+            }
+        }
+    }
+
+    void TryAdvance(uint64_t epoch) {
+        for (auto record = records_.load(); record; record = record->next_) {
+            uint64_t announced = record->announced_.load();
+            if (announced != kInactive && announced != epoch) {
+                return;
+            }
+        }
+        global_epoch_.compare_exchange_strong(epoch, epoch + 1);
+        FreeOrphans();
+    }
+
+    void Free(RetiredBucket &bucket) {
+        for (auto &retired : bucket.items_) {
+            retired.deleter_(retired.pointer_);
+        }
+        bucket.items_.clear();
+    }
+
+    void Orphan(RetiredBucket &bucket) {
+        if (bucket.items_.empty()) {
+            return;
+        }
+        std::unique_lock<std::mutex> lock_(orphans_mutex_);
+        orphans_.push_back(std::move(bucket));
+        bucket.items_.clear();
+        has_orphans_.store(true);
+    }
+
+    void FreeOrphans() {
+        if (!has_orphans_.load()) {
+            return;
+        }
+        std::unique_lock<std::mutex> lock_(orphans_mutex_, std::try_to_lock);
+        if (!lock_.owns_lock()) {
+            return;
+        }
+
+        uint64_t epoch = global_epoch_.load();
+        auto still_reachable = std::partition(orphans_.begin(), orphans_.end(), [epoch](const RetiredBucket &bucket) {
+            return bucket.epoch_ + 2 > epoch;
+        });
+        for (auto it = still_reachable; it != orphans_.end(); ++it) {
+            Free(*it);
+        }
+        orphans_.erase(still_reachable, orphans_.end());
+        has_orphans_.store(!orphans_.empty());
+    }
+
+private:
+    std::atomic<uint64_t> global_epoch_{0};
+    std::atomic<EpochRecord *> records_{nullptr};
+
+    std::mutex orphans_mutex_;
+    std::vector<RetiredBucket> orphans_;
+    std::atomic<bool> has_orphans_{false};
+};
+
+constexpr uint64_t EpochDomain::kInactive;
+constexpr size_t EpochDomain::kNumBuckets;
+constexpr size_t EpochDomain::kAdvancePeriod;
+
+template<typename T>
+class LockFreeQueue {
+    struct Node {
+        T item_{};
+        std::atomic<Node *> next_{nullptr};
+
+        Node() = default;
+
+        explicit Node(T item, Node *next = nullptr)
+                : item_(std::move(item)), next_(next) {
+        }
+    };
+
+public:
+    LockFreeQueue() {
+        auto *dummy = new Node{};
+        head_ = dummy;
+        tail_ = dummy;
+    }
+
+    ~LockFreeQueue() {
+        while (true) {
+            if (!head_.load()) {
+                break;
+            }
+            auto ptr = head_.load();
+            head_.store(head_.load()->next_);
+            delete ptr;
+        }
+    }
+
+    void Enqueue(T item) {
+        auto new_tail = new Node(std::move(item));
+        Append(new_tail, new_tail);
+    }
+
+    bool Dequeue(T &item) {
+        EpochDomain::Guard guard;
+
+        while (true) {
+            Node *curr_head = head_;
+            Node *curr_tail = tail_;
+
+            if (curr_head == curr_tail) {
+                if (!curr_head->next_) {
+                    return false;
+                } else {
+                    tail_.compare_exchange_weak(curr_head, curr_head->next_);
+                }
+            } else {
+                if (head_.compare_exchange_weak(curr_head, curr_head->next_)) {
+                    item = std::move(curr_head->next_.load()->item_);
+                    Retire(curr_head);
+                    return true;
+                }
+            }
+        }
+    }
+
+private:
+    void Append(Node *chain_head, Node *chain_tail) {
+        EpochDomain::Guard guard;
+        Node *curr_tail = nullptr;
+
+        while (true) {
+            curr_tail = tail_;
+            if (!curr_tail->next_) {
+                Node *temp_ptr = nullptr;
+                if (curr_tail->next_.compare_exchange_weak(temp_ptr, chain_head)) {
+                    break;
+                }
+            } else {
+                tail_.compare_exchange_weak(curr_tail, curr_tail->next_);
+            }
+        }
+
+        tail_.compare_exchange_strong(curr_tail, chain_tail);
+    }
+
+    static void Retire(Node *node) {
+        EpochDomain::Instance().Retire(node, [](void *ptr) {
+            delete static_cast<Node *>(ptr);
+        });
+    }
+
+private:
+    std::atomic<Node *> head_{nullptr};
+    std::atomic<Node *> tail_{nullptr};
+};
+
+constexpr size_t kCacheLineSize = 64;
+
+using Task = std::function<void()>;
+
+// Chase-Lev deque: the owner pushes and takes at the bottom, thieves steal from the top
+class WorkStealingDeque {
+    class Buffer {
+    public:
+        explicit Buffer(const int64_t capacity)
+                : capacity_(capacity), mask_(capacity - 1), cells_(new std::atomic<Task *>[capacity]) {
+        }
+
+        int64_t Capacity() const {
+            return capacity_;
+        }
+
+        Task *Get(const int64_t index) const {
+            return cells_[index & mask_].load(std::memory_order_relaxed);
+        }
+
+        void Put(const int64_t index, Task *task) {
+            cells_[index & mask_].store(task, std::memory_order_relaxed);
+        }
+
+        Buffer *Grow(const int64_t top, const int64_t bottom) const {
+            auto *buffer = new Buffer(capacity_ * 2);
+            for (int64_t index = top; index < bottom; ++index) {
+                buffer->Put(index, Get(index));
+            }
+            return buffer;
+        }
+
+    private:
+        const int64_t capacity_;
+        const int64_t mask_;
+        std::unique_ptr<std::atomic<Task *>[]> cells_;
+    };
+
+public:
+    explicit WorkStealingDeque(const int64_t capacity = 256) : buffer_(new Buffer(capacity)) {
+        buffers_.emplace_back(buffer_.load());
+    }
+
+    WorkStealingDeque(const WorkStealingDeque &) = delete;
+    WorkStealingDeque &operator=(const WorkStealingDeque &) = delete;
+
+    // owner only
+    void Push(Task *task) {
+        int64_t bottom = bottom_.load(std::memory_order_relaxed);
+        int64_t top = top_.load(std::memory_order_acquire);
+        Buffer *buffer = buffer_.load(std::memory_order_relaxed);
+        if (bottom - top > buffer->Capacity() - 1) {
+            // thieves may still read the old buffer, so it is kept until the deque dies
+            buffer = buffer->Grow(top, bottom);
+            buffers_.emplace_back(buffer);
+            buffer_.store(buffer, std::memory_order_release);
+        }
+        buffer->Put(bottom, task);
+        bottom_.store(bottom + 1, std::memory_order_release);
+    }
+
+    // owner only, returns nullptr if the deque is empty
+    Task *Take() {
+        int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+        Buffer *buffer = buffer_.load(std::memory_order_relaxed);
+        bottom_.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t top = top_.load(std::memory_order_relaxed);
+
+        if (top > bottom) {
+            bottom_.store(bottom + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        Task *task = buffer->Get(bottom);
+        if (top == bottom) {
+            // the last task: race the thieves for it
+            if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                task = nullptr;
+            }
+            bottom_.store(bottom + 1, std::memory_order_relaxed);
+        }
+        return task;
+    }
+
+    // any thread, returns nullptr if the deque is empty or another thread won the race
+    Task *Steal() {
+        int64_t top = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t bottom = bottom_.load(std::memory_order_acquire);
+        if (top >= bottom) {
+            return nullptr;
+        }
+
+        Buffer *buffer = buffer_.load(std::memory_order_acquire);
+        Task *task = buffer->Get(top);
+        if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return task;
+    }
+
+    bool Empty() const {
+        return top_.load() >= bottom_.load();
+    }
+
+private:
+    std::atomic<int64_t> top_{0};
+    char top_padding_[kCacheLineSize - sizeof(std::atomic<int64_t>)];
+    std::atomic<int64_t> bottom_{0};
+    std::atomic<Buffer *> buffer_;
+    char bottom_padding_[kCacheLineSize - sizeof(std::atomic<int64_t>) - sizeof(std::atomic<Buffer *>)];
+    std::vector<std::unique_ptr<Buffer>> buffers_;
+};
+
+class ThreadPool {
+    static constexpr size_t kStealRounds = 2;
+
+    struct Worker {
+        WorkStealingDeque deque_;
+        std::thread thread_;
+        ThreadPool *pool_;
+        uint64_t random_state_;
+    };
+
+public:
+    explicit ThreadPool(const size_t num_workers = std::max(1u, std::thread::hardware_concurrency())) {
+        for (size_t i = 0; i < num_workers; ++i) {
+            workers_.emplace_back(new Worker);
+            workers_.back()->pool_ = this;
+            workers_.back()->random_state_ = 0x9E3779B97F4A7C15ull * (i + 1);
+        }
+        for (auto &worker : workers_) {
+            Worker *self = worker.get();
+            worker->thread_ = std::thread([this, self] {
+                WorkerLoop(*self);
+            });
+        }
+    }
+
+    // runs every task submitted so far before joining the workers
+    ~ThreadPool() {
+        stopping_.store(true);
+        WakeWorkers(INT_MAX);
+        for (auto &worker : workers_) {
+            worker->thread_.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // from a worker the task goes to its own deque, from other threads to the shared injection queue
+    void Submit(Task task) {
+        auto *pending = new Task(std::move(task));
+        Worker *worker = CurrentWorker();
+        if (worker) {
+            worker->deque_.Push(pending);
+        } else {
+            injection_.Enqueue(pending);
+        }
+
+        // pairs with the fence in Park: either the sleeper sees the task or we see the sleeper
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepers_.load(std::memory_order_relaxed) > 0) {
+            WakeWorkers(1);
+        }
+    }
+
+    // lets a waiting thread help instead of blocking, returns false if no task was found
+    bool RunPendingTask() {
+        Task *task = FindTask(CurrentWorker());
+        if (!task) {
+            return false;
+        }
+        Run(task);
+        return true;
+    }
+
+    size_t NumWorkers() const {
+        return workers_.size();
+    }
+
+private:
+    Worker *CurrentWorker() {
+        Worker *worker = CurrentWorkerSlot();
+        return worker && worker->pool_ == this ? worker : nullptr;
+    }
+
+    static Worker *&CurrentWorkerSlot() {
+        thread_local Worker *worker = nullptr;
+        return worker;
+    }
+
+    void WorkerLoop(Worker &worker) {
+        CurrentWorkerSlot() = &worker;
+
+        while (true) {
+            Task *task = FindTask(&worker);
+            if (task) {
+                Run(task);
+            } else if (!Park(worker)) {
+                break;
+            }
+        }
+
+        CurrentWorkerSlot() = nullptr;
+    }
+
+    Task *FindTask(Worker *worker) {
+        Task *task = nullptr;
+        if (worker && (task = worker->deque_.Take())) {
+            return task;
+        }
+        if (injection_.Dequeue(task)) {
+            return task;
+        }
+        return Steal(worker);
+    }
+
+    Task *Steal(Worker *thief) {
+        size_t num_workers = workers_.size();
+        for (size_t round = 0; round < kStealRounds; ++round) {
+            size_t start = NextRandom(thief) % num_workers;
+            for (size_t i = 0; i < num_workers; ++i) {
+                Worker *victim = workers_[(start + i) % num_workers].get();
+                if (victim == thief) {
+                    continue;
+                }
+                Task *task = victim->deque_.Steal();
+                if (task) {
+                    return task;
+                }
+            }
+        }
+        return nullptr;
+    }
+
+    static uint64_t NextRandom(Worker *worker) {
+        thread_local uint64_t outsider_state = reinterpret_cast<uintptr_t>(&outsider_state) | 1;
+        uint64_t &state = worker ? worker->random_state_ : outsider_state;
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+
+    static void Run(Task *task) {
+        (*task)();
+        delete task;
+    }
+
+    // returns false when the pool is stopping and there is no work left
+    bool Park(Worker &worker) {
+        uint32_t epoch = wake_epoch_.load();
+        sleepers_.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        Task *task = FindTask(&worker);
+        if (task) {
+            sleepers_.fetch_sub(1);
+            Run(task);
+            return true;
+        }
+        if (stopping_.load()) {
+            // another worker still owns queued tasks: keep trying to steal them instead of sleeping
+            sleepers_.fetch_sub(1);
+            return HasQueuedTasks();
+        }
+
+        FutexWait(&wake_epoch_, epoch);
+        sleepers_.fetch_sub(1);
+        return true;
+    }
+
+    bool HasQueuedTasks() {
+        for (auto &worker : workers_) {
+            if (!worker->deque_.Empty()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void WakeWorkers(const int count) {
+        wake_epoch_.fetch_add(1);
+        FutexWake(&wake_epoch_, count);
+    }
+
+private:
+    std::vector<std::unique_ptr<Worker>> workers_;
+    LockFreeQueue<Task *> injection_;
+    std::atomic<bool> stopping_{false};
+
+    std::atomic<uint32_t> wake_epoch_{0};
+    std::atomic<uint32_t> sleepers_{0};
+};
+
+constexpr size_t ThreadPool::kStealRounds;
+
+// splits [begin, end) in halves until the pieces are at most grain long, the caller helps until all are done
+template<typename Function>
+void ParallelFor(ThreadPool &pool, const size_t begin, const size_t end, const size_t grain, Function func) {
+    struct State {
+        explicit State(Function function) : function_(std::move(function)) {
+        }
+
+        Function function_;
+        std::atomic<size_t> pending_{1};
+        std::atomic<uint32_t> done_{0};
+    };
+
+    struct Range {
+        static void Run(ThreadPool &pool, const std::shared_ptr<State> &state, size_t from, size_t to,
+                        const size_t grain) {
+            while (to - from > grain) {
+                size_t middle = from + (to - from) / 2;
+                state->pending_.fetch_add(1);
+                pool.Submit([&pool, state, middle, to, grain] {
+                    Run(pool, state, middle, to, grain);
+                });
+                to = middle;
+            }
+            for (size_t i = from; i < to; ++i) {
+                state->function_(i);
+            }
+            if (state->pending_.fetch_sub(1) == 1) {
+                state->done_.store(1);
+                FutexWake(&state->done_, INT_MAX);
+            }
+        }
+    };
+
+    if (begin >= end) {
+        return;
+    }
+
+    auto state = std::make_shared<State>(std::move(func));
+    Range::Run(pool, state, begin, end, std::max<size_t>(grain, 1));
+    while (!state->done_.load()) {
+        if (!pool.RunPendingTask()) {
+            FutexWait(&state->done_, 0);
+        }
+    }
+}
+
+void SpawnBenchmark(ThreadPool &pool, const size_t num_tasks) {
+    std::atomic<size_t> finished{0};
+
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < num_tasks; ++i) {
+        pool.Submit([&finished] {
+            finished.fetch_add(1, std::memory_order_relaxed);
+        });
+    }
+    while (finished.load() != num_tasks) {
+        pool.RunPendingTask();
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - begin;
+    std::cout << "external submit: " << elapsed.count() / num_tasks << " ns/task\n";
+
+    // the same number of tasks spawned by a worker onto its own deque
+    finished.store(0);
+    begin = std::chrono::steady_clock::now();
+    pool.Submit([&pool, &finished, num_tasks] {
+        for (size_t i = 0; i < num_tasks; ++i) {
+            pool.Submit([&finished] {
+                finished.fetch_add(1, std::memory_order_relaxed);
+            });
+        }
+    });
+    while (finished.load() != num_tasks) {
+        pool.RunPendingTask();
+    }
+    elapsed = std::chrono::steady_clock::now() - begin;
+    std::cout << "worker spawn: " << elapsed.count() / num_tasks << " ns/task\n";
+}
+
+void ParallelForBenchmark(ThreadPool &pool, const size_t size, const size_t grain) {
+    std::vector<double> values(size);
+    for (size_t i = 0; i < size; ++i) {
+        values[i] = static_cast<double>(i % 1000);
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < size; ++i) {
+        values[i] = std::sqrt(values[i] + 1.0);
+    }
+    std::chrono::duration<double, std::milli> serial = std::chrono::steady_clock::now() - begin;
+
+    begin = std::chrono::steady_clock::now();
+    ParallelFor(pool, 0, size, grain, [&values](size_t i) {
+        values[i] = std::sqrt(values[i] + 1.0);
+    });
+    std::chrono::duration<double, std::milli> parallel = std::chrono::steady_clock::now() - begin;
+
+    std::cout << "serial: " << serial.count() << " ms, parallel for (" << pool.NumWorkers() << " workers, grain "
+              << grain << "): " << parallel.count() << " ms\n";
+}
+
+int main(int argc, char **argv) {
+    std::string mode = argc > 1 ? argv[1] : "parallel-for";
+    ThreadPool pool;
+
+    if (mode == "parallel-for") {
+        size_t size = argc > 2 ? std::stoull(argv[2]) : 1 << 24;
+        size_t grain = argc > 3 ? std::stoull(argv[3]) : 1 << 12;
+        ParallelForBenchmark(pool, size, grain);
+    } else if (mode == "spawn") {
+        size_t num_tasks = argc > 2 ? std::stoull(argv[2]) : 1000000;
+        SpawnBenchmark(pool, num_tasks);
+    }
+
+    return 0;
+}